@@ -0,0 +1,369 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <libChip-8/include/audio.hpp>
+#include <libChip-8/include/chip8vm.hpp>
+#include <libChip-8/include/gif.hpp>
+#include <libChip-8/include/video.hpp>
+
+
+using namespace std;
+
+enum { SUCCEEDED, FAILED, USAGE };
+
+// A scripted key event, applied at the start of a frame.
+struct ScriptEvent
+{
+	uint32_t frame;
+	Chip8VM::Key key;
+	bool pressed;
+};
+
+// How each ROM is run.
+struct Options
+{
+	uint32_t frames = 600;						// Frames to run each ROM for.
+	uint32_t instructions_per_frame = 10;		// Instructions executed per frame.
+	uint64_t seed = Chip8VM::DEFAULT_SEED;		// Seed for the VM's random number generator.
+	unsigned threads = 0;						// Worker threads. 0 means one per core.
+	vector<ScriptEvent> script;					// Scripted input, sorted by frame.
+	string video;								// If set, "y4m" or "rgba", and each ROM's frames go to <rom>.<video>.
+	bool gif = false;							// Write each ROM's frames as an animated GIF to <rom>.gif.
+	unsigned scale = 1;							// Pixels per VM pixel in the video or GIF.
+	bool changed_only = false;					// Write only changed frames, with their times in <rom>.<video>.txt.
+	bool wav = false;							// Write each ROM's buzzer to <rom>.wav.
+};
+
+// The outcome of running a single ROM.
+struct Result
+{
+	bool loaded = false;
+	uint64_t hash = 0;
+	uint64_t instructions = 0;
+	double milliseconds = 0.0;
+};
+
+
+bool load_rom(Chip8VM& vm, const string& filename, uint64_t seed)
+{
+	// Load the ROM file into a buffer.
+	ifstream is(filename, ifstream::binary | ios::ate);
+	if (!is)
+	{
+		return false;
+	}
+	size_t len = static_cast<size_t>(is.tellg());
+	auto buffer = make_unique<Chip8VM::Byte[]>(len + 1);
+	is.seekg(0, is.beg);
+	is.read((char*)buffer.get(), len);
+	is.close();
+
+	// Supply the buffer to the Chip-8 VM, which rejects programs too large for its memory.
+	return vm.load(buffer.get(), len, seed);
+}
+
+
+// Reads a script of key events. Each line is "<frame> <down|up> <key>", where key is a hex digit. '#' starts a comment.
+bool load_script(const string& filename, vector<ScriptEvent>& script)
+{
+	ifstream is(filename);
+	if (!is)
+	{
+		return false;
+	}
+
+	string line;
+	while (getline(is, line))
+	{
+		line = line.substr(0, line.find('#'));
+		istringstream fields(line);
+		uint32_t frame;
+		string action;
+		unsigned key;
+		if (!(fields >> frame))
+		{
+			continue;
+		}
+		if (!(fields >> action >> hex >> key) || key > 0xf || (action != "down" && action != "up"))
+		{
+			cerr << filename << ": bad script line: " << line << endl;
+			return false;
+		}
+		script.push_back({ frame, static_cast<Chip8VM::Key>(key), action == "down" });
+	}
+
+	stable_sort(script.begin(), script.end(), [](const ScriptEvent& a, const ScriptEvent& b) { return a.frame < b.frame; });
+	return true;
+}
+
+
+// Runs a ROM for the configured number of frames, applying scripted input at the start of each frame.
+Result run_rom(const string& filename, const Options& options)
+{
+	Result result;
+	auto vm_handle = make_unique<Chip8VM>();
+	Chip8VM& vm = *vm_handle;
+
+	if (!load_rom(vm, filename, options.seed))
+	{
+		return result;
+	}
+	result.loaded = true;
+
+	// Capture the frames if asked to.
+	unique_ptr<ofstream> video_file, timestamp_file;
+	unique_ptr<VideoWriter> video;
+	if (!options.video.empty())
+	{
+		string video_filename = filename + "." + options.video;
+		video_file = make_unique<ofstream>(video_filename, ofstream::binary);
+		if (options.changed_only)
+		{
+			timestamp_file = make_unique<ofstream>(video_filename + ".txt");
+		}
+		auto format = options.video == "y4m" ? VideoWriter::Format::Y4M : VideoWriter::Format::RGBA;
+		video = make_unique<VideoWriter>(*video_file, format, options.scale, Palette(), 60, timestamp_file.get());
+	}
+	unique_ptr<ofstream> gif_file;
+	unique_ptr<GifWriter> gif;
+	if (options.gif)
+	{
+		gif_file = make_unique<ofstream>(filename + ".gif", ofstream::binary);
+		gif = make_unique<GifWriter>(*gif_file, options.scale);
+	}
+
+	unique_ptr<ofstream> wav_file;
+	unique_ptr<WavWriter> wav;
+	Beeper beeper;
+	int16_t samples[Beeper::MAXIMUM_TICK_SAMPLES];
+	if (options.wav)
+	{
+		wav_file = make_unique<ofstream>(filename + ".wav", ofstream::binary);
+		wav = make_unique<WavWriter>(*wav_file, beeper.sample_rate());
+	}
+
+	auto start = chrono::steady_clock::now();
+	auto event = options.script.begin();
+	for (uint32_t frame = 0; frame < options.frames; frame++)
+	{
+		for (; event != options.script.end() && event->frame == frame; ++event)
+		{
+			if (event->pressed)
+			{
+				vm.key_pressed(event->key);
+			}
+			else
+			{
+				vm.key_released(event->key);
+			}
+		}
+		vm.tick();
+		vm.step(options.instructions_per_frame);
+		if (video)
+		{
+			video->write(vm.io.screen);
+		}
+		if (gif)
+		{
+			gif->write(vm.io.screen);
+		}
+		if (wav)
+		{
+			wav->write(samples, beeper.tick(vm.is_sounding(), samples));
+		}
+	}
+	if (gif)
+	{
+		gif->finish();
+	}
+	if (wav)
+	{
+		wav->finish();
+	}
+	auto finish = chrono::steady_clock::now();
+
+	result.hash = vm.hash();
+	result.instructions = vm.instructions;
+	result.milliseconds = chrono::duration<double, milli>(finish - start).count();
+	return result;
+}
+
+
+// Adds the ROM filenames listed one per line in a file.
+bool read_list(const string& filename, vector<string>& roms)
+{
+	ifstream is(filename);
+	if (!is)
+	{
+		return false;
+	}
+	string line;
+	while (getline(is, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+		if (!line.empty())
+		{
+			roms.push_back(line);
+		}
+	}
+	return true;
+}
+
+
+void usage(const char* program)
+{
+	cerr << "Usage: " << program << " [options] <rom>... | @<listfile>\n"
+		<< "  --frames <n>         frames to run each ROM for (default 600)\n"
+		<< "  --ipf <n>            instructions per frame (default 10)\n"
+		<< "  --seed <n>           random number seed\n"
+		<< "  --script <file>      scripted input: lines of \"<frame> <down|up> <key>\"\n"
+		<< "  --threads <n>        worker threads (default: one per core)\n"
+		<< "  --video <y4m|rgba>   write each ROM's frames to <rom>.y4m or <rom>.rgba\n"
+		<< "  --gif                write each ROM's frames to <rom>.gif\n"
+		<< "  --scale <n>          pixels per VM pixel in the video or GIF (default 1)\n"
+		<< "  --changed-only       write only changed frames, with their times in <rom>.<y4m|rgba>.txt\n"
+		<< "  --wav                write each ROM's buzzer to <rom>.wav\n";
+}
+
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	vector<string> roms;
+
+	try
+	{
+		for (auto i = 1; i < argc; i++)
+		{
+			string arg = argv[i];
+			bool has_value = i + 1 < argc;
+			if (arg == "--frames" && has_value)
+			{
+				options.frames = stoul(argv[++i]);
+			}
+			else if (arg == "--ipf" && has_value)
+			{
+				options.instructions_per_frame = stoul(argv[++i]);
+			}
+			else if (arg == "--seed" && has_value)
+			{
+				options.seed = stoull(argv[++i], nullptr, 0);
+			}
+			else if (arg == "--threads" && has_value)
+			{
+				options.threads = stoul(argv[++i]);
+			}
+			else if (arg == "--video" && has_value && (string(argv[i + 1]) == "y4m" || string(argv[i + 1]) == "rgba"))
+			{
+				options.video = argv[++i];
+			}
+			else if (arg == "--scale" && has_value)
+			{
+				options.scale = stoul(argv[++i]);
+			}
+			else if (arg == "--gif")
+			{
+				options.gif = true;
+			}
+			else if (arg == "--changed-only")
+			{
+				options.changed_only = true;
+			}
+			else if (arg == "--wav")
+			{
+				options.wav = true;
+			}
+			else if (arg == "--script" && has_value)
+			{
+				if (!load_script(argv[++i], options.script))
+				{
+					cerr << "Unable to read script " << argv[i] << endl;
+					return FAILED;
+				}
+			}
+			else if (arg[0] == '@')
+			{
+				if (!read_list(arg.substr(1), roms))
+				{
+					cerr << "Unable to read ROM list " << arg.substr(1) << endl;
+					return FAILED;
+				}
+			}
+			else if (arg[0] == '-')
+			{
+				usage(argv[0]);
+				return USAGE;
+			}
+			else
+			{
+				roms.push_back(arg);
+			}
+		}
+	}
+	catch (const logic_error&)
+	{
+		// A malformed number.
+		usage(argv[0]);
+		return USAGE;
+	}
+
+	if (roms.empty())
+	{
+		usage(argv[0]);
+		return USAGE;
+	}
+
+	// Run the ROMs on a pool of worker threads, each taking the next unclaimed ROM.
+	vector<Result> results(roms.size());
+	atomic<size_t> next{ 0 };
+	auto worker = [&]() {
+		for (size_t n; (n = next++) < roms.size(); )
+		{
+			results[n] = run_rom(roms[n], options);
+		}
+	};
+
+	unsigned thread_count = options.threads ? options.threads : max(1u, thread::hardware_concurrency());
+	thread_count = min<unsigned>(thread_count, static_cast<unsigned>(roms.size()));
+	vector<thread> workers;
+	for (unsigned t = 1; t < thread_count; t++)
+	{
+		workers.emplace_back(worker);
+	}
+	worker();
+	for (auto& t : workers)
+	{
+		t.join();
+	}
+
+	// Report the results in the order that the ROMs were given.
+	int status = SUCCEEDED;
+	for (size_t n = 0; n < roms.size(); n++)
+	{
+		const Result& r = results[n];
+		if (!r.loaded)
+		{
+			cerr << roms[n] << ": unable to load (missing, or too large for the VM's memory)" << endl;
+			status = FAILED;
+			continue;
+		}
+		char line[64];
+		snprintf(line, sizeof(line), "%016llx\t%llu\t%.3f", (unsigned long long)r.hash, (unsigned long long)r.instructions, r.milliseconds);
+		cout << line << '\t' << roms[n] << '\n';
+	}
+
+	return status;
+}
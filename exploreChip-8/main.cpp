@@ -0,0 +1,566 @@
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <libChip-8/include/chip8vm.hpp>
+#include <libChip-8/include/rewind.hpp>
+
+
+using namespace std;
+
+enum { SUCCEEDED, FAILED, USAGE };
+
+// How the ROM is explored.
+struct Options
+{
+	uint32_t instructions_per_frame = 10;		// The timers tick once every this many instructions.
+	uint64_t budget = 60000;					// Instructions to run without input before splitting the run.
+	size_t max_states = 1 << 20;				// Stop once this many distinct states have been seen.
+	unsigned max_depth = 1000;					// Stop after this many levels of input.
+	unsigned threads = 0;						// Worker threads. 0 means one per core.
+	uint64_t seed = Chip8VM::DEFAULT_SEED;
+};
+
+
+// A fixed size, lock-free, open addressing set of state hashes. Zero marks an empty slot.
+class StateTable
+{
+	vector<atomic<uint64_t>> slots;
+	atomic<size_t> count{ 0 };
+	size_t mask;
+
+public:
+	explicit StateTable(size_t capacity)
+	{
+		size_t size = 1;
+		while (size < capacity * 2)
+		{
+			size <<= 1;
+		}
+		slots = vector<atomic<uint64_t>>(size);
+		for (auto& slot : slots)
+		{
+			slot.store(0, memory_order_relaxed);
+		}
+		mask = size - 1;
+	}
+
+	// Adds a hash to the table, returning true if it wasn't already there.
+	bool insert(uint64_t hash)
+	{
+		hash = hash ? hash : 1;
+		for (size_t i = hash & mask; ; i = (i + 1) & mask)
+		{
+			uint64_t expected = slots[i].load(memory_order_relaxed);
+			if (expected == hash)
+			{
+				return false;
+			}
+			if (expected == 0)
+			{
+				if (slots[i].compare_exchange_strong(expected, hash, memory_order_relaxed))
+				{
+					count.fetch_add(1, memory_order_relaxed);
+					return true;
+				}
+				if (expected == hash)
+				{
+					return false;
+				}
+			}
+		}
+	}
+
+	size_t size() const { return count.load(memory_order_relaxed); }
+};
+
+
+// A state waiting to be explored, and how it was reached. The state is kept as a delta against the starting state,
+// which it usually differs from in a few hundred bytes rather than the several kilobytes of a whole snapshot.
+struct Node
+{
+	vector<Chip8VM::Byte> delta;
+	uint32_t parent;		// The index of the parent node in the previous level.
+	uint8_t choice;			// The input that led here. See describe_choice().
+};
+
+// How a node was reached, kept for every level so that paths can be reported.
+struct Link
+{
+	uint32_t parent;
+	uint8_t choice;
+};
+
+// Choices. The low nibble is the key.
+const uint8_t CHOICE_WAIT = 0x00;			// LD Vx, K was satisfied with a key press.
+const uint8_t CHOICE_DOWN = 0x10;			// SKP / SKNP saw the key down.
+const uint8_t CHOICE_UP = 0x20;				// SKP / SKNP saw the key up.
+const uint8_t CHOICE_CONTINUE = 0x30;		// The run was split after the instruction budget, without input.
+
+// Something worth reporting, found at a given depth.
+struct Finding
+{
+	string what;
+	Chip8VM::Address pc;
+	unsigned depth;
+	uint32_t node;			// The node in that level whose run found it.
+};
+
+
+string describe_choice(uint8_t choice)
+{
+	const char* hex = "0123456789ABCDEF";
+	switch (choice & 0xf0)
+	{
+	case CHOICE_WAIT:
+		return string("K") + hex[choice & 0xf];
+	case CHOICE_DOWN:
+		return string("+") + hex[choice & 0xf];
+	case CHOICE_UP:
+		return string("-") + hex[choice & 0xf];
+	default:
+		return ".";
+	}
+}
+
+
+bool read_file(const string& filename, vector<Chip8VM::Byte>& buffer)
+{
+	ifstream is(filename, ifstream::binary | ios::ate);
+	if (!is)
+	{
+		return false;
+	}
+	buffer.resize(static_cast<size_t>(is.tellg()));
+	is.seekg(0, is.beg);
+	return static_cast<bool>(is.read((char*)buffer.data(), buffer.size()));
+}
+
+
+class Explorer
+{
+	const Options& options;
+	StateTable seen;
+	Chip8VM::State origin;					// The starting state, which nodes are stored as deltas against.
+	vector<vector<Link>> levels;
+	vector<Node> frontier;
+	vector<Node> next;
+	mutex lock;								// Guards next, findings and coverage when merging.
+	map<pair<string, Chip8VM::Address>, Finding> findings;
+	bitset<Chip8VM::MEMORY_SIZE> coverage;
+	unsigned depth = 0;
+
+	enum class Stop { INPUT, CYCLE, BUDGET, CRASH };
+
+	// Returns the key used to dedupe a state. States at different points in a frame behave differently.
+	uint64_t key_of(const Chip8VM& vm) const
+	{
+		return vm.hash() ^ Chip8Random::at(0x7068617365ull, vm.instructions % options.instructions_per_frame);
+	}
+
+	// Executes one instruction, ticking the timers at the start of each frame.
+	void advance(Chip8VM& vm) const
+	{
+		if (vm.instructions % options.instructions_per_frame == 0)
+		{
+			vm.tick();
+		}
+		vm.step(1);
+	}
+
+	// Returns a description of why the next instruction would crash the VM, or nullptr if it wouldn't.
+	static const char* check(const Chip8VM& vm, Chip8VM::Opcode opcode)
+	{
+		if (vm.reg.pc >= Chip8VM::MEMORY_SIZE - 1)
+		{
+			return "program counter out of range";
+		}
+		if (!Chip8VM::is_legal(opcode))
+		{
+			return "illegal instruction";
+		}
+		if ((opcode & 0xf000) == 0x2000 && vm.reg.sp == 15)
+		{
+			return "stack overflow";
+		}
+		if (opcode == 0x00ee && vm.reg.sp == 0)
+		{
+			return "stack underflow";
+		}
+		unsigned x = (opcode >> 8) & 0xf;
+		unsigned extent = 0;
+		switch (opcode & 0xf0ff)
+		{
+		case 0xf033:
+			extent = 3;
+			break;
+		case 0xf055:
+		case 0xf065:
+			extent = x + 1;
+			break;
+		}
+		if ((opcode & 0xf000) == 0xd000)
+		{
+			extent = opcode & 0xf;
+		}
+		if (vm.reg.i + extent > Chip8VM::MEMORY_SIZE)
+		{
+			return "memory access out of range";
+		}
+		return nullptr;
+	}
+
+	// Runs the VM until the next instruction reads the keyboard, it cycles without reading the keyboard, it runs out of
+	// budget or it would crash. Cycles are found with Brent's algorithm using the VM's constant time hash.
+	Stop run(Chip8VM& vm, bitset<Chip8VM::MEMORY_SIZE>& covered, const char*& crash) const
+	{
+		uint64_t marker = key_of(vm);
+		uint64_t power = 1;
+		uint64_t length = 0;
+		for (uint64_t n = 0; n < options.budget; n++)
+		{
+			Chip8VM::Address pc = vm.reg.pc;
+			Chip8VM::Opcode opcode = pc < Chip8VM::MEMORY_SIZE - 1 ? (vm.memory[pc] << 8) | vm.memory[pc + 1] : 0;
+			if ((crash = check(vm, opcode)) != nullptr)
+			{
+				return Stop::CRASH;
+			}
+			if ((opcode & 0xf0ff) == 0xe09e || (opcode & 0xf0ff) == 0xe0a1 || (opcode & 0xf0ff) == 0xf00a)
+			{
+				return Stop::INPUT;
+			}
+			covered.set(pc);
+			advance(vm);
+
+			uint64_t key = key_of(vm);
+			if (key == marker)
+			{
+				return Stop::CYCLE;
+			}
+			if (++length == power)
+			{
+				marker = key;
+				power <<= 1;
+				length = 0;
+			}
+		}
+		return Stop::BUDGET;
+	}
+
+	// Adds a child state to the next level if it hasn't been seen before. The scratch state saves a large allocation.
+	void offer(const Chip8VM& vm, uint32_t parent, uint8_t choice, Chip8VM::State& scratch, vector<Node>& out)
+	{
+		if (seen.size() < options.max_states && seen.insert(key_of(vm)))
+		{
+			out.emplace_back();
+			vm.save(scratch);
+			RewindBuffer::encode_delta(reinterpret_cast<const Chip8VM::Byte*>(&scratch),
+				reinterpret_cast<const Chip8VM::Byte*>(&origin), sizeof(scratch), out.back().delta);
+			out.back().parent = parent;
+			out.back().choice = choice;
+		}
+	}
+
+	// Explores one node of the frontier, producing its children. The VM only rejects states whose program counter or
+	// return addresses are outside memory, and such a state has crashed.
+	void expand(Chip8VM& vm, uint32_t index, Chip8VM::State& scratch, vector<Node>& out, vector<Finding>& found,
+		bitset<Chip8VM::MEMORY_SIZE>& covered)
+	{
+		scratch = origin;
+		RewindBuffer::apply_delta(frontier[index].delta, reinterpret_cast<Chip8VM::Byte*>(&scratch));
+		if (!vm.restore(scratch))
+		{
+			found.push_back({ "state could not be restored (address out of range)", scratch.pc, depth, index });
+			return;
+		}
+
+		const char* crash = nullptr;
+		switch (run(vm, covered, crash))
+		{
+		case Stop::CRASH:
+			found.push_back({ crash, vm.reg.pc, depth, index });
+			return;
+		case Stop::CYCLE:
+			found.push_back({ "soft-lock (loops without reading the keyboard)", vm.reg.pc, depth, index });
+			return;
+		case Stop::BUDGET:
+			offer(vm, index, CHOICE_CONTINUE, scratch, out);
+			return;
+		case Stop::INPUT:
+			break;
+		}
+
+		// Branch on every outcome of the instruction that reads the keyboard.
+		Chip8VM::State branch;
+		vm.save(branch);
+		Chip8VM::Address pc = vm.reg.pc;
+		Chip8VM::Opcode opcode = (vm.memory[pc] << 8) | vm.memory[pc + 1];
+		covered.set(pc);
+		if ((opcode & 0xf0ff) == 0xf00a)
+		{
+			for (unsigned k = 0; k < 16; k++)
+			{
+				if (!vm.restore(branch))
+				{
+					found.push_back({ "state could not be restored (address out of range)", pc, depth, index });
+					return;
+				}
+				auto key = static_cast<Chip8VM::Key>(k);
+				vm.key_pressed(key);
+				advance(vm);
+				vm.key_released(key);
+				offer(vm, index, static_cast<uint8_t>(CHOICE_WAIT | k), scratch, out);
+			}
+		}
+		else
+		{
+			unsigned k = vm.reg.v[(opcode >> 8) & 0xf];
+			if (k > 0xf)
+			{
+				found.push_back({ "key check out of range", pc, depth, index });
+				return;
+			}
+			for (auto down : { true, false })
+			{
+				if (!vm.restore(branch))
+				{
+					found.push_back({ "state could not be restored (address out of range)", pc, depth, index });
+					return;
+				}
+				auto key = static_cast<Chip8VM::Key>(k);
+				if (down)
+				{
+					vm.key_pressed(key);
+				}
+				else
+				{
+					vm.key_released(key);
+				}
+				advance(vm);
+				offer(vm, index, static_cast<uint8_t>((down ? CHOICE_DOWN : CHOICE_UP) | k), scratch, out);
+			}
+		}
+	}
+
+public:
+	Explorer(const Options& options) :
+		options(options),
+		seen(options.max_states)
+	{
+	}
+
+	// Explores breadth first from the VM's current state, one level of input at a time, with the nodes of each level
+	// shared between worker threads.
+	void explore(const Chip8VM& start)
+	{
+		start.save(origin);
+		frontier.emplace_back();
+		frontier.back().parent = 0;
+		frontier.back().choice = CHOICE_CONTINUE;
+		seen.insert(key_of(start));
+
+		unsigned thread_count = options.threads ? options.threads : max(1u, thread::hardware_concurrency());
+		for (depth = 0; !frontier.empty() && depth < options.max_depth && seen.size() < options.max_states; depth++)
+		{
+			vector<Link> links(frontier.size());
+			for (size_t n = 0; n < frontier.size(); n++)
+			{
+				links[n] = { frontier[n].parent, frontier[n].choice };
+			}
+			levels.push_back(move(links));
+
+			atomic<size_t> claimed{ 0 };
+			auto worker = [&]() {
+				auto vm_handle = make_unique<Chip8VM>();
+				auto scratch = make_unique<Chip8VM::State>();
+				vector<Node> out;
+				vector<Finding> found;
+				bitset<Chip8VM::MEMORY_SIZE> covered;
+				for (size_t n; (n = claimed++) < frontier.size(); )
+				{
+					expand(*vm_handle, static_cast<uint32_t>(n), *scratch, out, found, covered);
+				}
+
+				lock_guard<mutex> guard(lock);
+				move(out.begin(), out.end(), back_inserter(next));
+				for (auto& f : found)
+				{
+					findings.insert({ { f.what, f.pc }, f });
+				}
+				coverage |= covered;
+			};
+
+			unsigned count = min<unsigned>(thread_count, static_cast<unsigned>(frontier.size()));
+			vector<thread> workers;
+			for (unsigned t = 1; t < count; t++)
+			{
+				workers.emplace_back(worker);
+			}
+			worker();
+			for (auto& t : workers)
+			{
+				t.join();
+			}
+
+			frontier.swap(next);
+			next.clear();
+		}
+	}
+
+	// Returns the inputs that lead to a node.
+	string path(unsigned level, uint32_t node) const
+	{
+		vector<string> steps;
+		for (; level > 0; level--)
+		{
+			const Link& link = levels[level][node];
+			steps.push_back(describe_choice(link.choice));
+			node = link.parent;
+		}
+		string result;
+		for (auto step = steps.rbegin(); step != steps.rend(); ++step)
+		{
+			result += (result.empty() ? "" : " ") + *step;
+		}
+		return result.empty() ? "(start)" : result;
+	}
+
+	void report(size_t rom_size, ostream& os) const
+	{
+		os << "States: " << seen.size() << (seen.size() >= options.max_states ? " (limit reached)" : "") << "\n";
+		os << "Depth: " << depth << (frontier.empty() ? " (exhausted)" : " (incomplete)") << "\n";
+
+		os << "Never executed:";
+		bool any = false;
+		size_t end = min<size_t>(0x200 + rom_size, Chip8VM::MEMORY_SIZE);
+		for (size_t a = 0x200; a < end; a += 2)
+		{
+			if (!coverage.test(a) && !coverage.test(a + 1))
+			{
+				size_t b = a;
+				while (b + 2 < end && !coverage.test(b + 2) && !coverage.test(b + 3))
+				{
+					b += 2;
+				}
+				char range[32];
+				snprintf(range, sizeof(range), " %03zX-%03zX", a, b + 1);
+				os << range;
+				any = true;
+				a = b;
+			}
+		}
+		os << (any ? "" : " none") << "\n";
+
+		for (const auto& entry : findings)
+		{
+			const Finding& f = entry.second;
+			char pc[8];
+			snprintf(pc, sizeof(pc), "%03X", f.pc);
+			os << f.what << " at " << pc << ", depth " << f.depth << ": " << path(f.depth, f.node) << "\n";
+		}
+	}
+
+	bool found_problems() const { return !findings.empty(); }
+};
+
+
+void usage(const char* program)
+{
+	cerr << "Usage: " << program << " [options] <rom>\n"
+		<< "  --ipf <n>            instructions per frame (default 10)\n"
+		<< "  --budget <n>         instructions to run without input before splitting a run (default 60000)\n"
+		<< "  --max-states <n>     distinct states to explore (default 1048576)\n"
+		<< "  --max-depth <n>      levels of input to explore (default 1000)\n"
+		<< "  --seed <n>           random number seed\n"
+		<< "  --threads <n>        worker threads (default: one per core)\n";
+}
+
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	string rom_filename;
+	try
+	{
+		for (auto i = 1; i < argc; i++)
+		{
+			string arg = argv[i];
+			bool has_value = i + 1 < argc;
+			if (arg == "--ipf" && has_value)
+			{
+				options.instructions_per_frame = max(1ul, stoul(argv[++i]));
+			}
+			else if (arg == "--budget" && has_value)
+			{
+				options.budget = stoull(argv[++i]);
+			}
+			else if (arg == "--max-states" && has_value)
+			{
+				options.max_states = stoul(argv[++i]);
+			}
+			else if (arg == "--max-depth" && has_value)
+			{
+				options.max_depth = stoul(argv[++i]);
+			}
+			else if (arg == "--seed" && has_value)
+			{
+				options.seed = stoull(argv[++i], nullptr, 0);
+			}
+			else if (arg == "--threads" && has_value)
+			{
+				options.threads = stoul(argv[++i]);
+			}
+			else if (arg[0] != '-' && rom_filename.empty())
+			{
+				rom_filename = arg;
+			}
+			else
+			{
+				usage(argv[0]);
+				return USAGE;
+			}
+		}
+	}
+	catch (const logic_error&)
+	{
+		// A malformed number.
+		usage(argv[0]);
+		return USAGE;
+	}
+
+	if (rom_filename.empty())
+	{
+		usage(argv[0]);
+		return USAGE;
+	}
+
+	vector<Chip8VM::Byte> rom;
+	if (!read_file(rom_filename, rom))
+	{
+		cerr << "Unable to read ROM " << rom_filename << endl;
+		return FAILED;
+	}
+
+	auto vm_handle = make_unique<Chip8VM>();
+	if (!vm_handle->load(rom.data(), rom.size(), options.seed))
+	{
+		cerr << "ROM " << rom_filename << " is too large to load" << endl;
+		return FAILED;
+	}
+
+	auto explorer = make_unique<Explorer>(options);
+	explorer->explore(*vm_handle);
+	explorer->report(rom.size(), cout);
+
+	return explorer->found_problems() ? FAILED : SUCCEEDED;
+}
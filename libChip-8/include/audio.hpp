@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+
+using namespace std;
+
+
+// Generates the buzzer that sounds while the sound timer is nonzero, as a square wave of signed 16-bit mono samples.
+// Samples are made one timer tick at a time, into the caller's buffer, so the emulation thread can feed an audio
+// device without allocating. The wave's phase carries on across ticks so that a long beep has no seams.
+class Beeper
+{
+public:
+	static const uint32_t DEFAULT_SAMPLE_RATE = 44100;
+	static const uint32_t TICKS_PER_SECOND = 60;
+	static const size_t MAXIMUM_TICK_SAMPLES = 1024;	// The most samples a tick can make, at the highest sample rate.
+
+	Beeper(uint32_t sample_rate = DEFAULT_SAMPLE_RATE, uint32_t frequency = 440, int16_t amplitude = 4096);
+
+	size_t tick(bool on, int16_t* samples);
+
+	uint32_t sample_rate() const { return rate; }
+
+private:
+	uint32_t rate;
+	uint32_t phase_step;		// How far the wave moves per sample, as a fraction of a cycle in 32 bits.
+	uint32_t phase;
+	uint32_t remainder;			// Sixtieths of a sample carried over between ticks.
+	int16_t amplitude;
+};
+
+
+// Writes signed 16-bit mono samples as a WAV file. The sizes in the header are filled in by finish(), which needs a
+// seekable stream such as a file.
+class WavWriter
+{
+public:
+	WavWriter(ostream& out, uint32_t sample_rate = Beeper::DEFAULT_SAMPLE_RATE);
+
+	void write(const int16_t* samples, size_t count);
+	void finish();
+
+	uint64_t samples() const { return sample_count; }
+
+private:
+	ostream& out;
+	ostream::pos_type start;
+	uint64_t sample_count;
+	bool finished;
+
+	void put_header(uint32_t data_bytes, uint32_t sample_rate);
+	void put_word(uint32_t word, size_t bytes);
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "chip8vm.hpp"
+
+
+using namespace std;
+
+
+// A vectorized environment that runs N copies of a program in lock step, one frame per call. Actions and
+// observations live in contiguous buffers so that a learning agent can drive every instance with a single call.
+class Chip8Env
+{
+public:
+	using KeyMask = uint16_t;					// Bit n is set if key n is held down.
+	using RewardFunction = function<float(const Chip8VM& vm, size_t index)>;
+
+	static const int OBSERVATION_WORDS = Chip8VM::SCREEN_HEIGHT;	// One 64-bit word per screen row.
+
+private:
+	vector<Chip8VM> vms;
+	vector<Chip8VM::Byte> rom;
+	vector<KeyMask> held;						// The keys currently held down by each instance.
+	vector<uint64_t> observation_buffer;		// count * OBSERVATION_WORDS packed screen rows.
+	vector<float> reward_buffer;				// count rewards from the most recent step.
+	RewardFunction reward;
+	uint32_t instructions_per_frame;
+
+	void observe(size_t index);
+
+public:
+	Chip8Env(size_t count, const Chip8VM::Byte* data, size_t len, uint32_t instructions_per_frame = 10);
+
+	void reset(uint64_t seed = Chip8VM::DEFAULT_SEED);
+	void reset(size_t index, uint64_t seed);
+	void step(const KeyMask* actions);
+	void set_reward(RewardFunction reward);
+
+	// The number of instances.
+	size_t size() const { return vms.size(); }
+
+	// Instance n's screen is at observations() + n * OBSERVATION_WORDS. Row y's bit 63 - x is pixel (x, y).
+	const uint64_t* observations() const { return observation_buffer.data(); }
+
+	// The rewards from the most recent step, one per instance.
+	const float* rewards() const { return reward_buffer.data(); }
+
+	Chip8VM& vm(size_t index) { return vms[index]; }
+	const Chip8VM& vm(size_t index) const { return vms[index]; }
+};
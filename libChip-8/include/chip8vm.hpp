@@ -1,30 +1,96 @@
 #pragma once
 
 #include <array>
-#include <bitset>
-#include <random>
+#include <cstdint>
 #include <string>
 
 
 using namespace std;
 
 
+// A small counter-based random number generator. Its whole state is a seed and a counter, so reseeding is free,
+// snapshots are trivial, and the nth value of any stream can be computed independently of the others.
+struct Chip8Random
+{
+	uint64_t seed;		// Selects the stream.
+	uint64_t counter;	// Position within the stream.
+
+	// Returns the value at a given position in a given stream (SplitMix64).
+	static uint64_t at(uint64_t seed, uint64_t counter)
+	{
+		uint64_t z = seed + (counter + 1) * 0x9e3779b97f4a7c15ull;
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+
+	void reseed(uint64_t seed)
+	{
+		this->seed = seed;
+		counter = 0;
+	}
+
+	uint64_t next()
+	{
+		return at(seed, counter++);
+	}
+};
+
+
+// The screen, stored as one 64-bit word per row so that a sprite row can be drawn with a rotate, an AND and an XOR.
+// Pixel (x, y) is bit 63 - x of rows[y]. The accessors mirror bitset's, indexing pixels as x + y * 64.
+struct Chip8Screen
+{
+	static const uint32_t ALL_ROWS = 0xffffffff;
+
+	array<uint64_t, 32> rows;
+
+	// Bit y is set if row y has changed since the host last called clean(), e.g. after presenting the screen.
+	uint32_t dirty;
+
+	bool test(size_t pos) const { return ((rows[pos >> 6] >> (63 - (pos & 63))) & 1) != 0; }
+	bool any() const { return !none(); }
+	bool none() const
+	{
+		uint64_t lit = 0;
+		for (auto row : rows)
+		{
+			lit |= row;
+		}
+		return lit == 0;
+	}
+	void reset()
+	{
+		for (size_t y = 0; y < rows.size(); y++)
+		{
+			dirty |= rows[y] ? (1u << y) : 0;
+		}
+		rows.fill(0);
+	}
+
+	bool changed() const { return dirty != 0; }
+	void clean() { dirty = 0; }
+};
+
+
 class Chip8VM
 {
 public:
 	static const int SCREEN_WIDTH = 64;
 	static const int SCREEN_HEIGHT = 32;
 	static const int MEMORY_SIZE = 4096;
+	static const int MAXIMUM_PROGRAM_SIZE = MEMORY_SIZE - 0x200;	// Programs are loaded at 0x200.
+	static const uint64_t DEFAULT_SEED = 0x43484950382d3031ull;	// "CHIP8-01"
 
 	using Byte = uint8_t;
 	using Address = uint16_t;
 	using Opcode = uint16_t;
 
-	// The Chip-8 VM's memory.
+	// The Chip-8 VM's memory. Call rehash() after writing to it directly.
 	array<Byte, MEMORY_SIZE> memory;
 
 	struct {
-		bitset<SCREEN_WIDTH * SCREEN_HEIGHT> screen;	// The screen memory.
+		Chip8Screen screen;								// The screen memory.
 		array<bool, 16> keys;							// The keyboard.
 	} io;
 
@@ -51,6 +117,43 @@ public:
 	// The most recent key that was pressed.
 	Key key;
 
+	// The random number generator used by RND. Seeded by reset() and load().
+	Chip8Random random;
+
+	// The number of instructions executed since the last reset.
+	uint64_t instructions;
+
+	// A versioned, fixed layout snapshot of the VM in native byte order. It contains no pointers and no implicit
+	// padding, so it can be written to a file as is and mapped straight back into memory to be restored.
+	struct State
+	{
+		static const uint32_t MAGIC = 0x38504843;	// "CHP8"
+		static const uint32_t VERSION = 1;
+
+		uint32_t magic;
+		uint32_t version;
+		uint32_t size;								// sizeof(State), as a sanity check.
+		uint32_t reserved;
+		uint64_t instructions;
+		Chip8Random random;
+		array<uint64_t, SCREEN_HEIGHT> screen;		// One row per word, pixel x in bit 63 - x.
+		array<Address, 16> stack;
+		array<Byte, 16> v;
+		Address pc;
+		Address i;
+		Address here;
+		uint16_t keys;								// Bit n is set if key n is down.
+		Byte sp;
+		Byte dt;
+		Byte st;
+		Byte key;									// The most recent key, or 0xff for none.
+		Byte is_blocked;
+		Byte padding[3];
+		array<Byte, MEMORY_SIZE> memory;
+
+		bool is_valid() const;
+	};
+
 private:
 	// An instruction is just a member function pointer.
 	using Instruction = void(Chip8VM::*)();
@@ -60,10 +163,12 @@ private:
 
 	Address here;					// Purely used for 'compilation'.
 	bool is_blocked;				// true if the emulator is blocked (on I/O)
-	mt19937 random_number_engine;	// Mersenne Twister, for generating random numbers.
+	uint64_t memory_hash;			// XOR of the keys of every non-zero byte of memory, kept up to date by store().
+	uint64_t screen_hash;			// XOR of the keys of every non-blank row, kept up to date by i_cls() and i_drw_vx_vy_n().
 
 	// CHIP8 instructions. Mnemonics from http://devernay.free.fr/hacks/chip8/C8TECH10.HTM#3.1.
 	// Presented in numerical order.
+	void i_compile();			// xxxx - not yet compiled
 	void i_illegal();			// xxxx - illegal instruction
 	void i_cls();				// 00E0 - CLS
 	void i_ret();				// 00EE - RET
@@ -104,17 +209,27 @@ private:
 	void push(Address address);
 	Address pop();
 	void write_ram(Opcode opcode);
-	void write_shadow(Instruction i);
-	Instruction instruction_from_opcode(Opcode opcode);
+	void invalidate(Address address);
+	void store(Address address, Byte value);
+	static Instruction instruction_from_opcode(Opcode opcode);
 
 public:
 	Chip8VM();
 
-	void reset();
-	void load(Byte* data, size_t len);
+	void reset(uint64_t seed = DEFAULT_SEED);
+	bool load(Byte* data, size_t len, uint64_t seed = DEFAULT_SEED);
 	void compile(Opcode opcode);
 	void tick();
 	void step(uint32_t n = 1);
+	bool is_sounding() const { return reg.st > 0; }
+	bool is_waiting_for_key() const { return is_blocked; }
+	bool is_idle() const { return is_blocked && reg.dt == 0 && reg.st == 0; }
 	void key_pressed(Key key);
 	void key_released(Key key);
+	uint64_t hash() const;
+	void rehash();
+	void save(State& state) const;
+	bool restore(const State& state);
+
+	static bool is_legal(Opcode opcode);
 };
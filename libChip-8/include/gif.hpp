@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <ostream>
+
+#include "chip8vm.hpp"
+#include "pixels.hpp"
+
+
+using namespace std;
+
+
+// Writes a stream of screen frames as a looping animated GIF with a two-colour palette. Runs of identical frames become
+// a single frame with a longer delay, frames too short for a GIF's centisecond delays are dropped, and each frame only
+// encodes the band of rows that changed since the frame before. Pixels are LZW encoded straight from the packed rows.
+class GifWriter
+{
+public:
+	GifWriter(ostream& out, unsigned scale = 1, const Palette& palette = Palette(), unsigned fps = 60);
+
+	void write(const Chip8Screen& screen);
+	void finish();
+
+	// The number of frames offered to write(), and the number that were written to the GIF.
+	uint64_t frames() const { return frame_count; }
+	uint64_t written() const { return written_count; }
+
+private:
+	using Rows = array<uint64_t, Chip8VM::SCREEN_HEIGHT>;
+
+	ostream& out;
+	unsigned scale;
+	unsigned fps;
+	uint64_t frame_count;
+	uint64_t written_count;
+	bool finished;
+
+	Rows pending;					// The frame waiting for the next change to know its delay.
+	bool has_pending;
+	Rows previous;					// The last frame written, which the next one is drawn over.
+	uint64_t written_centiseconds;	// The total delay of the frames written so far.
+
+	// The LZW dictionary. With only two colours it's a binary trie: code n's children are at [n * 2] and [n * 2 + 1].
+	array<uint16_t, 4096 * 2> children;
+
+	// LZW output, packed into bytes least significant bit first and written in sub-blocks of up to 255 bytes.
+	uint32_t bits;
+	unsigned bit_count;
+	array<uint8_t, 256> block;
+	unsigned block_size;
+
+	uint64_t centiseconds(uint64_t frame) const { return (frame * 100 + fps / 2) / fps; }
+	void write_frame(const Rows& rows, uint64_t delay);
+	void encode(const Rows& rows, unsigned first, unsigned last);
+	void put_code(unsigned code, unsigned size);
+	void put_byte(uint8_t byte);
+	void put_word(uint16_t word);
+};
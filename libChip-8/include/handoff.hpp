@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+using namespace std;
+
+
+// Hands the latest value from one thread to another without locks, e.g. frames from an emulation thread to a render
+// thread. The writer fills the back buffer and publishes it, and the reader takes the most recently published buffer.
+// Neither ever waits for the other: the writer always has a buffer to fill and the reader always has one to read, and
+// values that the reader doesn't get to in time are overwritten.
+template <typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() : back_index(0), middle(1), front_index(2) {}
+
+	// The writer's buffer, which it may change freely until it's published.
+	T& back() { return buffers[back_index]; }
+
+	// Swaps the back buffer with the middle one, marking it fresh for the reader.
+	void publish()
+	{
+		back_index = middle.exchange(back_index | FRESH, memory_order_acq_rel) & INDEX;
+	}
+
+	// Takes the middle buffer if something was published since the last update, returning true if there was.
+	bool update()
+	{
+		if ((middle.load(memory_order_relaxed) & FRESH) == 0)
+		{
+			return false;
+		}
+		front_index = middle.exchange(front_index, memory_order_acq_rel) & INDEX;
+		return true;
+	}
+
+	// The reader's buffer, which stays the same until the next update.
+	const T& front() const { return buffers[front_index]; }
+
+private:
+	static const uint8_t INDEX = 3;
+	static const uint8_t FRESH = 4;
+
+	array<T, 3> buffers;
+
+	// The indices are kept on separate cache lines so that the threads don't slow each other down.
+	alignas(64) uint8_t back_index;
+	alignas(64) atomic<uint8_t> middle;	// The middle buffer's index, with FRESH set if it hasn't been read.
+	alignas(64) uint8_t front_index;
+};
+
+
+// A fixed size queue from one producer thread to one consumer thread, e.g. input events from the UI to the emulation
+// thread, or audio samples to the audio callback. Pushing and popping never lock or allocate. The capacity must be a
+// power of two.
+template <typename T, size_t CAPACITY>
+class SpscQueue
+{
+	static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0, "The capacity must be a power of two");
+
+public:
+	SpscQueue() : head(0), tail(0), cached_head(0), cached_tail(0) {}
+
+	// Adds an item to the back of the queue, returning false if it's full. Only the producer may call this.
+	bool push(const T& item)
+	{
+		size_t back = tail.load(memory_order_relaxed);
+		if (back - cached_head == CAPACITY)
+		{
+			cached_head = head.load(memory_order_acquire);
+			if (back - cached_head == CAPACITY)
+			{
+				return false;
+			}
+		}
+		items[back & (CAPACITY - 1)] = item;
+		tail.store(back + 1, memory_order_release);
+		return true;
+	}
+
+	// Removes the item at the front of the queue, returning false if it's empty. Only the consumer may call this.
+	bool pop(T& item)
+	{
+		size_t front = head.load(memory_order_relaxed);
+		if (front == cached_tail)
+		{
+			cached_tail = tail.load(memory_order_acquire);
+			if (front == cached_tail)
+			{
+				return false;
+			}
+		}
+		item = items[front & (CAPACITY - 1)];
+		head.store(front + 1, memory_order_release);
+		return true;
+	}
+
+	// Adds as many of the items as there's space for, returning how many were added. Only the producer may call this.
+	size_t push(const T* source, size_t count)
+	{
+		size_t back = tail.load(memory_order_relaxed);
+		if (CAPACITY - (back - cached_head) < count)
+		{
+			cached_head = head.load(memory_order_acquire);
+		}
+		count = min(count, CAPACITY - (back - cached_head));
+		for (size_t n = 0; n < count; n++)
+		{
+			items[(back + n) & (CAPACITY - 1)] = source[n];
+		}
+		tail.store(back + count, memory_order_release);
+		return count;
+	}
+
+	// Removes up to count items, returning how many were removed. Only the consumer may call this.
+	size_t pop(T* destination, size_t count)
+	{
+		size_t front = head.load(memory_order_relaxed);
+		if (cached_tail - front < count)
+		{
+			cached_tail = tail.load(memory_order_acquire);
+		}
+		count = min(count, cached_tail - front);
+		for (size_t n = 0; n < count; n++)
+		{
+			destination[n] = items[(front + n) & (CAPACITY - 1)];
+		}
+		head.store(front + count, memory_order_release);
+		return count;
+	}
+
+	// The number of items queued, which may already be out of date when it's used.
+	size_t size() const
+	{
+		return tail.load(memory_order_acquire) - head.load(memory_order_acquire);
+	}
+
+private:
+	array<T, CAPACITY> items;
+
+	// Each side keeps a copy of the other's index, so that it only touches the other's cache line when it seems to
+	// have run out of items or space.
+	alignas(64) atomic<size_t> head;	// The next item to pop, written by the consumer.
+	alignas(64) atomic<size_t> tail;	// The next slot to push into, written by the producer.
+	alignas(64) size_t cached_head;		// The producer's copy of head.
+	alignas(64) size_t cached_tail;		// The consumer's copy of tail.
+};
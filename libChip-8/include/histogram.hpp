@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+
+using namespace std;
+
+
+// A histogram of durations that any number of threads can record into at once without locks, e.g. frame times from
+// a render loop while another thread reports on them. Buckets are log-linear: each power of two nanoseconds is split
+// into eight, so a bucket's value is within 12.5% of the durations in it, from nanoseconds up to centuries.
+class LatencyHistogram
+{
+public:
+	using Duration = chrono::nanoseconds;
+
+	static const size_t SUB_BUCKETS = 8;
+	static const size_t BUCKETS = 64 * SUB_BUCKETS;
+
+	// Statistics in nanoseconds. Percentiles are the representative values of the buckets they fall in.
+	struct Summary
+	{
+		uint64_t count;
+		uint64_t mean;
+		uint64_t p50;
+		uint64_t p90;
+		uint64_t p99;
+		uint64_t maximum;
+	};
+
+	LatencyHistogram();
+
+	void record(Duration duration);
+	Summary summary() const;
+	Summary take();
+
+	static size_t bucket(uint64_t nanoseconds);
+	static uint64_t bucket_value(size_t bucket);
+	static void write_heading(ostream& out);
+	static void write(ostream& out, const char* name, const Summary& summary);
+
+private:
+	array<atomic<uint64_t>, BUCKETS> counts;
+	atomic<uint64_t> total;			// The sum of the durations recorded, for the mean.
+	atomic<uint64_t> maximum;
+
+	static Summary summarise(const array<uint64_t, BUCKETS>& counts, uint64_t total, uint64_t maximum);
+};
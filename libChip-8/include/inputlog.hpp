@@ -0,0 +1,80 @@
+#pragma once
+
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "chip8vm.hpp"
+
+
+using namespace std;
+
+
+// A recording of everything that reaches a VM from outside during a session: key presses, key releases and timer
+// ticks, each stamped with the number of instructions the VM had executed when it happened. Replaying the events
+// against the same program with the same seed reproduces the session exactly.
+class InputLog
+{
+public:
+	static const uint32_t MAGIC = 0x4c493843;	// "C8IL"
+	static const uint32_t VERSION = 4;
+
+	enum class Type : uint8_t { KEY_DOWN, KEY_UP, TICK };
+
+	struct Event
+	{
+		uint64_t instructions;	// The VM's instruction count when the event happened.
+		Type type;
+		uint8_t key;			// The key, for KEY_DOWN and KEY_UP.
+		uint8_t padding[6];
+	};
+
+	// The VM's state at a point in the session, so that the session can be verified in independent segments.
+	struct Checkpoint
+	{
+		uint64_t event;			// The number of events recorded before the checkpoint was taken.
+		uint64_t hash;			// The VM's hash when the checkpoint was taken.
+		Chip8VM::State state;
+	};
+
+	uint64_t seed = Chip8VM::DEFAULT_SEED;	// The seed that the VM was loaded with.
+	uint64_t rom_hash = 0;					// Identifies the program that was recorded.
+	uint64_t end = 0;						// The VM's instruction count at the end of the session.
+	uint64_t end_hash = 0;					// The VM's hash at the end of the session.
+	vector<Event> events;
+	vector<Checkpoint> checkpoints;
+
+	void start(const Chip8VM::Byte* data, size_t len, uint64_t seed);
+	void record(const Chip8VM& vm, Type type, Chip8VM::Key key = Chip8VM::Key::NO_KEY);
+	void checkpoint(const Chip8VM& vm);
+	void truncate(const Chip8VM& vm, size_t event_count);
+	void finish(const Chip8VM& vm);
+
+	bool save(const string& filename) const;
+	bool save(ostream& os) const;
+	bool load(const string& filename);
+	bool load(istream& is);
+
+	static uint64_t hash_rom(const Chip8VM::Byte* data, size_t len);
+	static void apply(Chip8VM& vm, const Event& event);
+};
+
+
+bool run_to(Chip8VM& vm, uint64_t instructions);
+// Called with the VM at the end of each frame of a replay, just before the timer tick that starts the next.
+using FrameCallback = function<void(const Chip8VM& vm)>;
+
+bool replay(Chip8VM& vm, const InputLog& log, Chip8VM::Byte* data, size_t len, FrameCallback on_frame = nullptr);
+
+// The outcome of replaying the part of a log between two checkpoints.
+struct SegmentResult
+{
+	uint64_t start;			// The instruction count that the segment starts at.
+	uint64_t end;			// The instruction count that the segment ends at.
+	bool matched;			// true if replaying the segment reproduced the recorded hash at its end.
+};
+
+SegmentResult verify_segment(const InputLog& log, size_t segment, Chip8VM::Byte* data, size_t len);
+vector<SegmentResult> verify(const InputLog& log, Chip8VM::Byte* data, size_t len, unsigned threads = 0);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "chip8vm.hpp"
+#include "pixels.hpp"
+
+
+using namespace std;
+
+
+// Simulates the persistence of a phosphor screen to hide the flicker of XOR-drawn sprites. Each pixel has an intensity
+// that jumps to full when the pixel is lit and fades away over a few ticks once it goes out. Call tick() whenever the
+// VM ticks, then render() the blended frame.
+class Phosphor
+{
+public:
+	static const int WIDTH = Chip8VM::SCREEN_WIDTH;
+	static const int HEIGHT = Chip8VM::SCREEN_HEIGHT;
+
+	// decay is the fraction of its intensity, out of 256, that an unlit pixel keeps each tick.
+	Phosphor(uint8_t decay = 0x80, const Palette& palette = Palette());
+
+	void tick(const Chip8Screen& screen);
+	void render(uint8_t* pixels, size_t pitch) const;
+	void set_palette(const Palette& palette);
+	void reset();
+
+	// One byte per pixel, row by row, from 0 (dark) to 255 (lit).
+	const uint8_t* intensities() const { return intensity.data(); }
+
+private:
+	alignas(16) array<uint8_t, WIDTH * HEIGHT> intensity;
+	array<uint32_t, 256> colours;		// The RGBA8 pixel for each intensity.
+	uint8_t decay;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+using namespace std;
+
+
+// The pixel formats that a screen can be expanded into.
+enum class PixelFormat
+{
+	RGBA8,		// Four bytes per pixel: red, green, blue, alpha.
+	RGB565,		// One native-endian 16-bit word per pixel: 5 bits of red, 6 of green and 5 of blue.
+	GRAY8,		// One byte of luminance per pixel.
+};
+
+// The instruction sets that the expansion kernels are written for, from slowest to fastest.
+enum class SimdLevel
+{
+	SCALAR,
+	SSE2,
+	AVX2,
+};
+
+// The colours of unlit and lit pixels, as 0xAARRGGBB.
+struct Palette
+{
+	uint32_t off;
+	uint32_t on;
+
+	Palette(uint32_t off = 0xff000000, uint32_t on = 0xffffffff) : off(off), on(on) {}
+};
+
+size_t bytes_per_pixel(PixelFormat format);
+
+// The fastest instruction set that this build and this CPU both support.
+SimdLevel supported_simd_level();
+
+// Expands count packed screen rows (bit 63 - x of a row is pixel x, as in Chip8Screen) into count * scale lines of
+// 64 * scale pixels. Line n starts at pixels + n * pitch. The level defaults to the fastest that's supported, and a
+// level that isn't supported falls back to one that is.
+void expand_pixels(const uint64_t* rows, size_t count, PixelFormat format, const Palette& palette, unsigned scale,
+	void* pixels, size_t pitch);
+void expand_pixels(const uint64_t* rows, size_t count, PixelFormat format, const Palette& palette, unsigned scale,
+	void* pixels, size_t pitch, SimdLevel level);
+
+// As above, for an image whose rows are words 64-bit words wide, such as the output of the upscalers.
+void expand_image(const uint64_t* image, size_t words, size_t height, PixelFormat format, const Palette& palette,
+	unsigned scale, void* pixels, size_t pitch);
+void expand_image(const uint64_t* image, size_t words, size_t height, PixelFormat format, const Palette& palette,
+	unsigned scale, void* pixels, size_t pitch, SimdLevel level);
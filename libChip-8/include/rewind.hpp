@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+
+#include "chip8vm.hpp"
+
+
+using namespace std;
+
+
+// A fixed size history of recent VM states for rewinding. Every interval'th frame is stored as a full keyframe. The
+// frames in between are stored as run-length encoded XORs against their keyframe, so seeking to any frame costs one
+// keyframe copy plus one delta, and an unchanging frame costs a few bytes.
+class RewindBuffer
+{
+public:
+	RewindBuffer(size_t capacity = 3600, size_t interval = 60);
+
+	void push(const Chip8VM& vm);
+	bool seek(uint64_t frame, Chip8VM& vm) const;
+	bool rewind(uint64_t frame, Chip8VM& vm);
+	void clear();
+
+	// The oldest and newest frames that can be sought. Only meaningful if the buffer isn't empty.
+	uint64_t oldest() const { return first; }
+	uint64_t newest() const { return count - 1; }
+	bool empty() const { return count == 0; }
+
+	size_t bytes() const;
+
+	// Deltas can also be used on their own, to keep many states that differ little from a common one compactly.
+	static void encode_delta(const Chip8VM::Byte* current, const Chip8VM::Byte* key, size_t len,
+		vector<Chip8VM::Byte>& out);
+	static void apply_delta(const vector<Chip8VM::Byte>& delta, Chip8VM::Byte* state);
+
+private:
+	using Byte = Chip8VM::Byte;
+
+	vector<vector<Byte>> slots;		// Indexed by frame % slots.size(). Storage is reused as the buffer wraps.
+	size_t interval;				// Frames per keyframe.
+	uint64_t count;					// The number of frames pushed.
+	uint64_t first;					// The oldest frame whose keyframe hasn't been overwritten.
+	Chip8VM::State keyframe;		// The keyframe that new frames are encoded against.
+
+	bool decode(uint64_t frame, Chip8VM::State& state) const;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+
+using namespace std;
+
+
+// Paces a VM against a monotonic clock: the CPU runs at a set number of instructions per second and the timers tick at
+// exactly 60 Hz, whatever the display's refresh rate. Host time is accumulated in nanoseconds and converted to whole
+// instructions and ticks from a fixed origin, so rounding never drifts. Each tick happens at the instruction boundary
+// that matches its time.
+class Scheduler
+{
+public:
+	using Clock = chrono::steady_clock;
+	using TickFunction = function<void()>;
+	using StepFunction = function<void(uint32_t instructions)>;
+
+	static const uint32_t TIMER_HZ = 60;
+	static const uint32_t DEFAULT_RATE = 600;
+
+	// Time beyond this in a single advance, e.g. while the host was suspended, is dropped rather than caught up on.
+	static const Clock::duration MAXIMUM_LAG;
+
+	Scheduler(uint32_t instructions_per_second = DEFAULT_RATE);
+
+	void advance(Clock::duration elapsed, const TickFunction& tick, const StepFunction& step);
+	Clock::duration until_tick() const;
+
+	void set_rate(uint32_t instructions_per_second);
+	uint32_t rate() const { return instructions_per_second; }
+
+	// The instructions and ticks scheduled since the scheduler was created.
+	uint64_t instructions() const { return total_instructions; }
+	uint64_t ticks() const { return total_ticks; }
+
+private:
+	uint32_t instructions_per_second;
+
+	// Progress since the origin, which moves forward a second at a time to keep the arithmetic from overflowing.
+	uint64_t elapsed;				// Nanoseconds.
+	uint64_t executed;				// Instructions.
+	uint64_t ticked;				// Timer ticks.
+	uint64_t total_instructions;
+	uint64_t total_ticks;
+
+	uint64_t instruction_at(uint64_t nanoseconds) const;
+};
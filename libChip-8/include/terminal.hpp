@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "chip8vm.hpp"
+
+
+using namespace std;
+
+
+// Draws the screen on an ANSI terminal with Unicode characters. Braille characters fit 2x4 pixels in each character
+// cell, giving a 32x8 character picture. Half blocks fit 1x2 pixels, giving 64x16 characters, and work in more fonts.
+// Only the cells that have changed since the last render are sent, so an unchanging screen costs nothing.
+class TerminalRenderer
+{
+public:
+	enum class Mode { BRAILLE, HALF_BLOCK };
+
+	// The picture's top left corner is at the given 1-based row and column of the terminal.
+	TerminalRenderer(Mode mode = Mode::BRAILLE, unsigned top = 1, unsigned left = 1);
+
+	size_t render(const Chip8Screen& screen, string& out);
+	void invalidate();
+
+	unsigned columns() const { return cell_width ? Chip8VM::SCREEN_WIDTH / cell_width : 0; }
+	unsigned rows() const { return cell_height ? Chip8VM::SCREEN_HEIGHT / cell_height : 0; }
+
+private:
+	static const uint16_t UNKNOWN = 0xffff;
+
+	Mode mode;
+	unsigned top;
+	unsigned left;
+	unsigned cell_width;
+	unsigned cell_height;
+	vector<uint16_t> cells;		// The pixels shown in each cell, as a bit pattern, or UNKNOWN if it must be redrawn.
+
+	uint16_t pattern(const Chip8Screen& screen, unsigned column, unsigned row) const;
+	static void append_character(uint16_t pattern, Mode mode, string& out);
+};
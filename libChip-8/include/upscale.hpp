@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+using namespace std;
+
+
+// Pixel-art upscalers for packed one-bit images. An image is height rows of words 64-bit words, with pixel x of a row
+// in bit 63 - x % 64 of word x / 64, so the screen is an image of one word by 32 rows. Each filter works on a whole word
+// of pixels at once with bitwise operations, treating pixels beyond the edges as copies of the edge pixels.
+
+// Scales an image up by two using the Scale2x rules. out must have room for height * 2 rows of words * 2 words.
+void scale2x(const uint64_t* in, size_t words, size_t height, uint64_t* out);
+
+// Scales an image up by three using the Scale3x rules. out must have room for height * 3 rows of words * 3 words.
+void scale3x(const uint64_t* in, size_t words, size_t height, uint64_t* out);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <ostream>
+#include <vector>
+
+#include "chip8vm.hpp"
+#include "pixels.hpp"
+
+
+using namespace std;
+
+
+// Writes a stream of screen frames as uncompressed video, for piping into an encoder. Y4M streams are 4:4:4 YUV with a
+// header that describes them. RGBA streams are bare frames of RGBA8 pixels that the reader must be told the size of.
+//
+// Normally every frame is written, so the stream plays at the frame rate. If a timestamp stream is given, frames that
+// are the same as the one before are skipped instead, and the time of each frame that is written goes to the timestamp
+// stream in milliseconds, one per line, in the "timecode format v2" that muxers such as mkvmerge accept.
+class VideoWriter
+{
+public:
+	enum class Format { Y4M, RGBA };
+
+	VideoWriter(ostream& out, Format format, unsigned scale = 1, const Palette& palette = Palette(), unsigned fps = 60,
+		ostream* timestamps = nullptr);
+
+	void write(const Chip8Screen& screen);
+
+	unsigned width() const { return Chip8VM::SCREEN_WIDTH * scale; }
+	unsigned height() const { return Chip8VM::SCREEN_HEIGHT * scale; }
+
+	// The number of frames offered to write(), and the number that were written to the stream.
+	uint64_t frames() const { return frame_count; }
+	uint64_t written() const { return written_count; }
+
+private:
+	ostream& out;
+	ostream* timestamps;
+	Format format;
+	unsigned scale;
+	unsigned fps;
+	Palette planes[3];						// Y4M's Y, U and V values as greys, or the colours in planes[0] for RGBA.
+	vector<uint8_t> frame;					// The expanded frame, reused from frame to frame.
+	array<uint64_t, Chip8VM::SCREEN_HEIGHT> last;
+	uint64_t frame_count;
+	uint64_t written_count;
+
+	void render(const Chip8Screen& screen);
+};
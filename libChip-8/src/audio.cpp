@@ -0,0 +1,114 @@
+#include "audio.hpp"
+
+#include <algorithm>
+
+
+Beeper::Beeper(uint32_t sample_rate, uint32_t frequency, int16_t amplitude) :
+	rate(min<uint32_t>(max<uint32_t>(sample_rate, 8000), MAXIMUM_TICK_SAMPLES * TICKS_PER_SECOND)),
+	phase(0),
+	remainder(0),
+	amplitude(amplitude)
+{
+	phase_step = static_cast<uint32_t>((uint64_t(frequency) << 32) / rate);
+}
+
+
+// Writes the samples for one timer tick, a sixtieth of a second, returning how many there are. The count varies by one
+// from tick to tick when the sample rate isn't a multiple of 60, so that there are exactly sample_rate per second.
+size_t Beeper::tick(bool on, int16_t* samples)
+{
+	size_t count = (remainder + rate) / TICKS_PER_SECOND;
+	remainder = (remainder + rate) % TICKS_PER_SECOND;
+
+	if (!on)
+	{
+		fill(samples, samples + count, int16_t(0));
+		return count;
+	}
+	for (size_t n = 0; n < count; n++, phase += phase_step)
+	{
+		samples[n] = phase < 0x80000000u ? amplitude : static_cast<int16_t>(-amplitude);
+	}
+	return count;
+}
+
+
+// Writes a header with empty sizes, for finish() to fill in.
+WavWriter::WavWriter(ostream& out, uint32_t sample_rate) :
+	out(out),
+	start(out.tellp()),
+	sample_count(0),
+	finished(false)
+{
+	put_header(0, sample_rate);
+}
+
+
+void WavWriter::write(const int16_t* samples, size_t count)
+{
+	// Convert to little-endian a block at a time.
+	char bytes[512];
+	for (size_t done = 0; done < count; )
+	{
+		size_t block = min(count - done, sizeof(bytes) / 2);
+		for (size_t n = 0; n < block; n++)
+		{
+			uint16_t sample = static_cast<uint16_t>(samples[done + n]);
+			bytes[n * 2] = static_cast<char>(sample & 0xff);
+			bytes[n * 2 + 1] = static_cast<char>(sample >> 8);
+		}
+		out.write(bytes, block * 2);
+		done += block;
+	}
+	sample_count += count;
+}
+
+
+// Fills in the header's sizes. Nothing more can be written afterwards.
+void WavWriter::finish()
+{
+	if (finished)
+	{
+		return;
+	}
+	finished = true;
+	if (start == ostream::pos_type(-1))
+	{
+		return;
+	}
+	auto end = out.tellp();
+	uint32_t data_bytes = static_cast<uint32_t>(min<uint64_t>(sample_count * 2, 0xffffffffu - 36));
+	out.seekp(start + ostream::off_type(4));
+	put_word(data_bytes + 36, 4);
+	out.seekp(start + ostream::off_type(40));
+	put_word(data_bytes, 4);
+	out.seekp(end);
+	out.flush();
+}
+
+
+void WavWriter::put_header(uint32_t data_bytes, uint32_t sample_rate)
+{
+	out.write("RIFF", 4);
+	put_word(data_bytes + 36, 4);
+	out.write("WAVEfmt ", 8);
+	put_word(16, 4);					// The size of the format chunk.
+	put_word(1, 2);						// PCM.
+	put_word(1, 2);						// Mono.
+	put_word(sample_rate, 4);
+	put_word(sample_rate * 2, 4);		// Bytes per second.
+	put_word(2, 2);						// Bytes per sample.
+	put_word(16, 2);					// Bits per sample.
+	out.write("data", 4);
+	put_word(data_bytes, 4);
+}
+
+
+// Writes a little-endian word of the given number of bytes.
+void WavWriter::put_word(uint32_t word, size_t bytes)
+{
+	for (size_t n = 0; n < bytes; n++, word >>= 8)
+	{
+		out.put(static_cast<char>(word & 0xff));
+	}
+}
@@ -0,0 +1,91 @@
+#include "chip8env.hpp"
+
+#include <algorithm>
+
+
+// Creates an environment with count instances of the given program. A program too large for the VM's memory leaves
+// every instance with no program.
+Chip8Env::Chip8Env(size_t count, const Chip8VM::Byte* data, size_t len, uint32_t instructions_per_frame) :
+	vms(count),
+	rom(data, data + len),
+	held(count),
+	observation_buffer(count * OBSERVATION_WORDS),
+	reward_buffer(count),
+	instructions_per_frame(instructions_per_frame)
+{
+	// Pad odd length programs so that the last opcode is complete.
+	if (rom.size() & 1)
+	{
+		rom.push_back(0);
+	}
+	reset();
+}
+
+
+// Resets every instance. Instance n is seeded with seed + n so that the instances diverge.
+void Chip8Env::reset(uint64_t seed)
+{
+	for (size_t n = 0; n < vms.size(); n++)
+	{
+		reset(n, seed + n);
+	}
+}
+
+
+// Resets a single instance, e.g. at the end of its episode.
+void Chip8Env::reset(size_t index, uint64_t seed)
+{
+	vms[index].load(rom.data(), rom.size(), seed);
+	held[index] = 0;
+	reward_buffer[index] = 0.0f;
+	observe(index);
+}
+
+
+// Applies each instance's action, then advances every instance by one frame.
+void Chip8Env::step(const KeyMask* actions)
+{
+	for (size_t n = 0; n < vms.size(); n++)
+	{
+		Chip8VM& vm = vms[n];
+
+		// Only tell the VM about keys whose state has changed.
+		KeyMask changed = held[n] ^ actions[n];
+		for (unsigned k = 0; changed; k++, changed >>= 1)
+		{
+			if (changed & 1)
+			{
+				auto key = static_cast<Chip8VM::Key>(k);
+				if (actions[n] & (1 << k))
+				{
+					vm.key_pressed(key);
+				}
+				else
+				{
+					vm.key_released(key);
+				}
+			}
+		}
+		held[n] = actions[n];
+
+		vm.tick();
+		vm.step(instructions_per_frame);
+		observe(n);
+		reward_buffer[n] = reward ? reward(vm, n) : 0.0f;
+	}
+}
+
+
+// Sets the function used to compute each instance's reward after a step.
+void Chip8Env::set_reward(RewardFunction reward)
+{
+	this->reward = reward;
+}
+
+
+// Packs an instance's screen into its slot in the observation buffer.
+void Chip8Env::observe(size_t index)
+{
+	const auto& rows = vms[index].io.screen.rows;
+	copy(rows.begin(), rows.end(), &observation_buffer[index * OBSERVATION_WORDS]);
+}
@@ -1,5 +1,57 @@
 #include "chip8vm.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+
+static_assert(is_trivially_copyable<Chip8VM::State>::value, "Chip8VM::State must be trivially copyable");
+static_assert(sizeof(Chip8VM::State) == 360 + Chip8VM::MEMORY_SIZE, "Chip8VM::State must not contain padding");
+
+// Defined here as well as initialised in the class, so that it can be bound to a reference.
+const uint32_t Chip8Screen::ALL_ROWS;
+
+
+// Scrambles a 64-bit value (the SplitMix64 finalizer).
+static inline uint64_t mix64(uint64_t z)
+{
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+
+// The contribution of a byte of memory to the state hash. Zero bytes contribute nothing, so cleared memory hashes to 0.
+static inline uint64_t memory_key(unsigned address, uint8_t value)
+{
+	return value ? mix64(0x6d656d6f72790000ull + (address << 8) + value) : 0;
+}
+
+
+// Salts that make the same pixels contribute differently to the state hash on each row.
+static const array<uint64_t, Chip8VM::SCREEN_HEIGHT> row_salts = []() {
+	array<uint64_t, Chip8VM::SCREEN_HEIGHT> salts;
+	for (size_t y = 0; y < salts.size(); y++)
+	{
+		salts[y] = mix64(0x726f777300000000ull + y);
+	}
+	return salts;
+}();
+
+
+// The contribution of a row of the screen to the state hash. Blank rows contribute nothing.
+static inline uint64_t row_key(unsigned y, uint64_t row)
+{
+	return row ? mix64(row ^ row_salts[y]) : 0;
+}
+
+
+// Rotates a 64-bit value right. Compilers turn this into a single instruction.
+static inline uint64_t rotate_right(uint64_t value, unsigned n)
+{
+	return (value >> n) | (value << ((64 - n) & 63));
+}
+
 
 // Fonts (source: https://github.com/DanTup/DaChip8/blob/master/DaChip8/Font.cs)
 static uint8_t font[] = {
@@ -25,30 +77,44 @@ static uint8_t font[] = {
 // The VM's constructor.
 Chip8VM::Chip8VM()
 {
-	copy(&font[0], &font[sizeof(font)], memory.begin());
 	reset();
 }
 
 
-// Resets the VM.
-void Chip8VM::reset()
+// Resets the VM, seeding its random number generator so that runs are reproducible.
+void Chip8VM::reset(uint64_t seed)
 {
-	shadow.fill(&Chip8VM::i_illegal);
+	memory.fill(0);
+	copy(&font[0], &font[sizeof(font)], memory.begin());
+	shadow.fill(&Chip8VM::i_compile);
+	io.screen.dirty = Chip8Screen::ALL_ROWS;
 	io.screen.reset();
+	screen_hash = 0;
 	io.keys.fill(false);
 	reg.pc = 0x200;
+	reg.v.fill(0);
+	reg.i = 0;
+	reg.stack.fill(0);
 	here = 0x200;
 	reg.sp = 0;
+	reg.dt = 0;
+	reg.st = 0;
 	is_blocked = false;
 	key = Key::NO_KEY;
-	random_number_engine.seed(random_device{}());
+	random.reseed(seed);
+	instructions = 0;
+	memory_hash = 0;
+	for (unsigned address = 0; address < sizeof(font); address++)
+	{
+		memory_hash ^= memory_key(address, font[address]);
+	}
 }
 
 
 // Returns a random byte from 0 to 255 inclusive.
 Chip8VM::Byte Chip8VM::rnd()
 {
-	return uniform_int_distribution<int>(0, 255)(random_number_engine);
+	return static_cast<Byte>(random.next() >> 56);
 }
 
 
@@ -77,15 +143,26 @@ Chip8VM::Address Chip8VM::pop()
 // Writes an opcode into two consecutive bytes of VM memory at the 'here' pointer.
 void Chip8VM::write_ram(Opcode opcode)
 {
-	memory[here] = opcode >> 8;
-	memory[here + 1] = opcode & 0xff;
+	store(here, opcode >> 8);
+	store(here + 1, opcode & 0xff);
+}
+
+
+// Marks the shadow memory for any opcode overlapping an address as needing to be recompiled.
+void Chip8VM::invalidate(Address address)
+{
+	shadow[address & (MEMORY_SIZE - 1)] = &Chip8VM::i_compile;
+	shadow[(address - 1) & (MEMORY_SIZE - 1)] = &Chip8VM::i_compile;
 }
 
 
-// Writes an instruction into shadow memory at the 'here' pointer.
-void Chip8VM::write_shadow(Instruction i)
+// Writes a byte to VM memory, keeping the memory hash and the shadow memory up to date.
+void Chip8VM::store(Address address, Byte value)
 {
-	shadow[here] = i;
+	address &= MEMORY_SIZE - 1;
+	memory_hash ^= memory_key(address, memory[address]) ^ memory_key(address, value);
+	memory[address] = value;
+	invalidate(address);
 }
 
 
@@ -210,15 +287,28 @@ Chip8VM::Instruction Chip8VM::instruction_from_opcode(Opcode opcode)
 }
 
 
-// Loads a program into VM memory and compiles it.
-void Chip8VM::load(Byte* data, size_t len)
+// Returns true if an opcode is one that the VM implements.
+bool Chip8VM::is_legal(Opcode opcode)
 {
-	reset();
+	return instruction_from_opcode(opcode) != &Chip8VM::i_illegal;
+}
+
+
+// Loads a program into VM memory and compiles it. Returns false, leaving the VM reset with no program, if the program
+// is too large to fit.
+bool Chip8VM::load(Byte* data, size_t len, uint64_t seed)
+{
+	reset(seed);
+	if (len > MAXIMUM_PROGRAM_SIZE)
+	{
+		return false;
+	}
 	for (size_t i = 0; i < len; i += 2)
 	{
-		Opcode opcode = (data[i] << 8) | data[i + 1];
+		Opcode opcode = (data[i] << 8) | (i + 1 < len ? data[i + 1] : 0);
 		compile(opcode);
 	}
+	return true;
 }
 
 
@@ -226,12 +316,21 @@ void Chip8VM::load(Byte* data, size_t len)
 void Chip8VM::compile(Opcode opcode)
 {
 	write_ram(opcode);
-	auto instruction = instruction_from_opcode(opcode);
-	write_shadow(instruction);
 	here += 2;
 }
 
 
+// Compiles the opcode at the program counter into shadow memory, then executes it. Shadow memory is filled with
+// this instruction on reset and wherever VM memory changes, so the shadow is always a cache of VM memory.
+void Chip8VM::i_compile()
+{
+	Opcode opcode = (memory[reg.pc] << 8) | memory[(reg.pc + 1) & (MEMORY_SIZE - 1)];
+	Instruction instruction = instruction_from_opcode(opcode);
+	shadow[reg.pc] = instruction;
+	(this->*instruction)();
+}
+
+
 // Executes an illegal instruction as a NOP (no operation).
 void Chip8VM::i_illegal()
 {
@@ -243,6 +342,7 @@ void Chip8VM::i_illegal()
 void Chip8VM::i_cls()
 {
 	io.screen.reset();
+	screen_hash = 0;
 	reg.pc += 2;
 }
 
@@ -460,24 +560,22 @@ void Chip8VM::i_drw_vx_vy_n()
 	Byte vx = memory[reg.pc] & 0x0f;
 	Byte vy = memory[reg.pc + 1] >> 4;
 	Byte n = memory[reg.pc + 1] & 0x0f;
-	auto x = reg.v[vx];
+	auto x = reg.v[vx] & 0x3f;
 	auto y = reg.v[vy];
-	bool vf = false;
+	uint64_t collisions = 0;
 	for (auto row = 0; row < n; row++)
 	{
-		auto data = memory[reg.i + row];
+		// Place the sprite's byte at the left of the row and rotate it into position, wrapping around the edge.
+		uint64_t sprite = rotate_right(uint64_t(memory[reg.i + row]) << 56, x);
 		auto sy = (y + row) & 0x1f;
-		for (auto col = 0; col < 8; col++)
-		{
-			if (data & (0x80 >> col))
-			{
-				auto sx = (x + col) & 0x3f;
-				vf = vf || io.screen.test(sx + sy * 64);
-				io.screen.flip(sx + sy * 64);
-			}
-		}
+		uint64_t& line = io.screen.rows[sy];
+		screen_hash ^= row_key(sy, line);
+		collisions |= line & sprite;
+		line ^= sprite;
+		screen_hash ^= row_key(sy, line);
+		io.screen.dirty |= sprite ? (1u << sy) : 0;
 	}
-	reg.v[0x0f] = vf ? 1 : 0;
+	reg.v[0x0f] = collisions ? 1 : 0;
 
 	reg.pc += 2;
 }
@@ -566,9 +664,9 @@ void Chip8VM::i_ld_b_vx()
 	Byte vx = memory[reg.pc] & 0x0f;
 	auto address = reg.i;
 	unsigned b = reg.v[vx];
-	memory[address] = (b / 100) % 10;
-	memory[address + 1] = (b / 10) % 10;
-	memory[address + 2] = b % 10;
+	store(address, (b / 100) % 10);
+	store(address + 1, (b / 10) % 10);
+	store(address + 2, b % 10);
 	reg.pc += 2;
 }
 
@@ -580,7 +678,7 @@ void Chip8VM::i_ld_i_vx()
 	auto address = reg.i;
 	for (auto i = 0; i <= vx; i++)
 	{
-		memory[address + i] = reg.v[i];
+		store(address + i, reg.v[i]);
 	}
 	reg.pc += 2;
 }
@@ -599,13 +697,18 @@ void Chip8VM::i_ld_vx_i()
 }
 
 
-// Decrements the delay timer. Should be called 60 times/second.
+// Decrements the delay and sound timers. Should be called 60 times/second. The buzzer sounds while the sound timer is
+// nonzero.
 void Chip8VM::tick()
 {
 	if (reg.dt > 0)
 	{
 		--reg.dt;
 	}
+	if (reg.st > 0)
+	{
+		--reg.st;
+	}
 }
 
 
@@ -616,6 +719,7 @@ void Chip8VM::step(uint32_t n)
 	{
 		Instruction op = shadow[reg.pc];
 		(this->*op)();
+		++instructions;
 	}
 }
 
@@ -640,3 +744,137 @@ void Chip8VM::key_released(Key key)
 		io.keys[static_cast<unsigned>(key)] = false;
 	}
 }
+
+
+// Returns a 64-bit hash of the VM's architectural state (memory, screen, registers, stack, timers and random number
+// generator) and of its keyboard, which determines what the program does next. Memory and the screen are hashed
+// incrementally as they change, so this only has to fold in the registers and runs in constant time.
+uint64_t Chip8VM::hash() const
+{
+	uint64_t words[10];
+	memcpy(&words[0], reg.v.data(), 16);
+	memcpy(&words[2], reg.stack.data(), 32);
+	uint16_t keys = 0;
+	for (auto k = 0; k < 16; k++)
+	{
+		keys |= io.keys[k] ? (1 << k) : 0;
+	}
+	words[6] = reg.pc | (uint64_t(reg.i) << 16) | (uint64_t(keys) << 32) | (uint64_t(reg.sp) << 48) | (uint64_t(is_blocked) << 56);
+	words[7] = reg.dt | (reg.st << 8) | (static_cast<Byte>(key) << 16);
+	words[8] = random.seed;
+	words[9] = random.counter;
+
+	uint64_t h = mix64(memory_hash) ^ screen_hash;
+	for (auto word : words)
+	{
+		h = mix64(h ^ word) + 0x9e3779b97f4a7c15ull;
+	}
+	return h;
+}
+
+
+// Recalculates the memory and screen hashes from scratch. Only needed after writing to memory or io.screen directly.
+void Chip8VM::rehash()
+{
+	memory_hash = 0;
+	for (unsigned address = 0; address < MEMORY_SIZE; address++)
+	{
+		memory_hash ^= memory_key(address, memory[address]);
+	}
+	screen_hash = 0;
+	for (auto y = 0; y < SCREEN_HEIGHT; y++)
+	{
+		screen_hash ^= row_key(y, io.screen.rows[y]);
+	}
+}
+
+
+// Saves the VM's state into a snapshot.
+void Chip8VM::save(State& state) const
+{
+	state.magic = State::MAGIC;
+	state.version = State::VERSION;
+	state.size = sizeof(State);
+	state.reserved = 0;
+	state.instructions = instructions;
+	state.random = random;
+	state.screen = io.screen.rows;
+	state.stack = reg.stack;
+	state.v = reg.v;
+	state.pc = reg.pc;
+	state.i = reg.i;
+	state.here = here;
+	state.keys = 0;
+	for (auto k = 0; k < 16; k++)
+	{
+		state.keys |= io.keys[k] ? (1 << k) : 0;
+	}
+	state.sp = reg.sp;
+	state.dt = reg.dt;
+	state.st = reg.st;
+	state.key = static_cast<Byte>(key);
+	state.is_blocked = is_blocked ? 1 : 0;
+	memset(state.padding, 0, sizeof(state.padding));
+	state.memory = memory;
+}
+
+
+// Restores the VM's state from a snapshot, returning false if the snapshot isn't valid. Only the shadow memory
+// behind bytes that differ from the current VM memory is invalidated, and it is recompiled when next executed.
+bool Chip8VM::restore(const State& state)
+{
+	if (!state.is_valid())
+	{
+		return false;
+	}
+
+	for (auto address = 0; address < MEMORY_SIZE; address += 8)
+	{
+		if (memcmp(&memory[address], &state.memory[address], 8) != 0)
+		{
+			for (auto a = address; a < address + 8; a++)
+			{
+				if (memory[a] != state.memory[a])
+				{
+					store(a, state.memory[a]);
+				}
+			}
+		}
+	}
+
+	instructions = state.instructions;
+	random = state.random;
+	screen_hash = 0;
+	for (auto y = 0; y < SCREEN_HEIGHT; y++)
+	{
+		io.screen.dirty |= (io.screen.rows[y] != state.screen[y]) ? (1u << y) : 0;
+		io.screen.rows[y] = state.screen[y];
+		screen_hash ^= row_key(y, io.screen.rows[y]);
+	}
+	reg.stack = state.stack;
+	reg.v = state.v;
+	reg.pc = state.pc;
+	reg.i = state.i;
+	here = state.here;
+	for (auto k = 0; k < 16; k++)
+	{
+		io.keys[k] = (state.keys & (1 << k)) != 0;
+	}
+	reg.sp = state.sp;
+	reg.dt = state.dt;
+	reg.st = state.st;
+	key = state.key < 16 ? static_cast<Key>(state.key) : Key::NO_KEY;
+	is_blocked = state.is_blocked != 0;
+	return true;
+}
+
+
+// Returns true if this looks like a snapshot that this version of the VM can restore. Snapshots may come from a file,
+// so the program counter and return addresses, which index shadow memory directly, are checked to be within memory.
+// I and the compile pointer legitimately run past the end of memory, e.g. after ADD I, Vx or loading a full-size ROM.
+bool Chip8VM::State::is_valid() const
+{
+	auto in_memory = [](Address address) { return address < MEMORY_SIZE; };
+	return magic == MAGIC && version == VERSION && size == sizeof(State) && sp < 16 &&
+		in_memory(pc) && all_of(stack.begin(), stack.end(), in_memory);
+}
@@ -0,0 +1,236 @@
+#include "gif.hpp"
+
+
+// GIF requires LZW codes to start at least three bits wide, even for two colours.
+static const unsigned MINIMUM_CODE_SIZE = 2;
+static const unsigned CLEAR_CODE = 1 << MINIMUM_CODE_SIZE;
+static const unsigned END_CODE = CLEAR_CODE + 1;
+static const unsigned FIRST_CODE = CLEAR_CODE + 2;
+static const unsigned MAXIMUM_CODES = 4096;
+
+// Browsers show frames with delays below 2 centiseconds for 10, so shorter frames are dropped.
+static const uint64_t MINIMUM_DELAY = 2;
+
+
+// Writes the GIF's header, palette and looping extension.
+GifWriter::GifWriter(ostream& out, unsigned scale, const Palette& palette, unsigned fps) :
+	out(out),
+	scale(scale ? scale : 1),
+	fps(fps ? fps : 60),
+	frame_count(0),
+	written_count(0),
+	finished(false),
+	has_pending(false),
+	written_centiseconds(0),
+	bits(0),
+	bit_count(0),
+	block_size(0)
+{
+	out.write("GIF89a", 6);
+	put_word(static_cast<uint16_t>(Chip8VM::SCREEN_WIDTH * this->scale));
+	put_word(static_cast<uint16_t>(Chip8VM::SCREEN_HEIGHT * this->scale));
+	put_byte(0x80);								// A global colour table of two colours.
+	put_byte(0);								// Background colour.
+	put_byte(0);								// Square pixels.
+	for (uint32_t colour : { palette.off, palette.on })
+	{
+		put_byte(static_cast<uint8_t>(colour >> 16));
+		put_byte(static_cast<uint8_t>(colour >> 8));
+		put_byte(static_cast<uint8_t>(colour));
+	}
+
+	// Loop forever.
+	out.write("\x21\xff\x0bNETSCAPE2.0\x03\x01\x00\x00\x00", 19);
+}
+
+
+// Offers the next frame. A frame is written once the next different frame shows how long it lasted.
+void GifWriter::write(const Chip8Screen& screen)
+{
+	if (!has_pending)
+	{
+		pending = screen.rows;
+		has_pending = true;
+	}
+	else if (screen.rows != pending)
+	{
+		uint64_t delay = centiseconds(frame_count) - written_centiseconds;
+		if (delay >= MINIMUM_DELAY)
+		{
+			write_frame(pending, delay);
+		}
+		pending = screen.rows;
+	}
+	++frame_count;
+}
+
+
+// Writes the last frame and the trailer. Nothing more can be written afterwards.
+void GifWriter::finish()
+{
+	if (finished)
+	{
+		return;
+	}
+	if (has_pending)
+	{
+		uint64_t delay = centiseconds(frame_count) - written_centiseconds;
+		write_frame(pending, delay < MINIMUM_DELAY ? MINIMUM_DELAY : delay);
+		has_pending = false;
+	}
+	put_byte(0x3b);
+	out.flush();
+	finished = true;
+}
+
+
+// Writes a frame that stays up for the given delay, drawing only the rows that differ from the previous frame.
+void GifWriter::write_frame(const Rows& rows, uint64_t delay)
+{
+	unsigned first = 0;
+	unsigned last = Chip8VM::SCREEN_HEIGHT - 1;
+	if (written_count > 0)
+	{
+		while (first < last && rows[first] == previous[first])
+		{
+			first++;
+		}
+		while (last > first && rows[last] == previous[last])
+		{
+			last--;
+		}
+	}
+
+	// Graphic control extension: leave each frame in place for the next to draw over, after the delay.
+	put_byte(0x21);
+	put_byte(0xf9);
+	put_byte(4);
+	put_byte(1 << 2);
+	put_word(static_cast<uint16_t>(delay < 0xffff ? delay : 0xffff));
+	put_byte(0);
+	put_byte(0);
+
+	// Image descriptor for the band of changed rows.
+	put_byte(0x2c);
+	put_word(0);
+	put_word(static_cast<uint16_t>(first * scale));
+	put_word(static_cast<uint16_t>(Chip8VM::SCREEN_WIDTH * scale));
+	put_word(static_cast<uint16_t>((last - first + 1) * scale));
+	put_byte(0);
+
+	encode(rows, first, last);
+
+	previous = rows;
+	written_centiseconds += delay;
+	++written_count;
+}
+
+
+// LZW encodes rows first to last, scaled up, reading pixels straight from the packed rows.
+void GifWriter::encode(const Rows& rows, unsigned first, unsigned last)
+{
+	put_byte(MINIMUM_CODE_SIZE);
+
+	unsigned size = MINIMUM_CODE_SIZE + 1;
+	unsigned next = FIRST_CODE;
+	children[0] = children[1] = children[2] = children[3] = 0;
+	put_code(CLEAR_CODE, size);
+
+	// The code for the pixels matched so far, or -1 before the first pixel.
+	int node = -1;
+	for (auto y = first; y <= last; y++)
+	{
+		for (unsigned line = 0; line < scale; line++)
+		{
+			uint64_t row = rows[y];
+			for (auto x = 0; x < Chip8VM::SCREEN_WIDTH; x++, row <<= 1)
+			{
+				unsigned pixel = static_cast<unsigned>(row >> 63);
+				for (unsigned repeat = 0; repeat < scale; repeat++)
+				{
+					if (node < 0)
+					{
+						node = pixel;
+						continue;
+					}
+					uint16_t child = children[node * 2 + pixel];
+					if (child)
+					{
+						node = child;
+						continue;
+					}
+
+					// The match can't be extended, so emit it and add the extended match to the dictionary, or start
+					// again once the dictionary is full.
+					put_code(node, size);
+					if (next < MAXIMUM_CODES)
+					{
+						if (next == (1u << size))
+						{
+							size++;
+						}
+						children[next * 2] = children[next * 2 + 1] = 0;
+						children[node * 2 + pixel] = static_cast<uint16_t>(next++);
+					}
+					else
+					{
+						put_code(CLEAR_CODE, size);
+						size = MINIMUM_CODE_SIZE + 1;
+						next = FIRST_CODE;
+						children[0] = children[1] = children[2] = children[3] = 0;
+					}
+					node = pixel;
+				}
+			}
+		}
+	}
+	put_code(node, size);
+	put_code(END_CODE, size);
+
+	// Flush the last bits and sub-block, then end the image data with an empty sub-block.
+	if (bit_count > 0)
+	{
+		block[++block_size] = static_cast<uint8_t>(bits);
+		bits = 0;
+		bit_count = 0;
+	}
+	if (block_size > 0)
+	{
+		block[0] = static_cast<uint8_t>(block_size);
+		out.write(reinterpret_cast<const char*>(block.data()), block_size + 1);
+		block_size = 0;
+	}
+	put_byte(0);
+}
+
+
+void GifWriter::put_code(unsigned code, unsigned size)
+{
+	bits |= code << bit_count;
+	bit_count += size;
+	while (bit_count >= 8)
+	{
+		block[++block_size] = static_cast<uint8_t>(bits);
+		bits >>= 8;
+		bit_count -= 8;
+		if (block_size == 255)
+		{
+			block[0] = 255;
+			out.write(reinterpret_cast<const char*>(block.data()), 256);
+			block_size = 0;
+		}
+	}
+}
+
+
+void GifWriter::put_byte(uint8_t byte)
+{
+	out.put(static_cast<char>(byte));
+}
+
+
+void GifWriter::put_word(uint16_t word)
+{
+	put_byte(static_cast<uint8_t>(word));
+	put_byte(static_cast<uint8_t>(word >> 8));
+}
@@ -0,0 +1,141 @@
+#include "histogram.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+
+// Defined here as well as initialised in the class, so that they can be bound to references.
+const size_t LatencyHistogram::SUB_BUCKETS;
+const size_t LatencyHistogram::BUCKETS;
+
+
+LatencyHistogram::LatencyHistogram() :
+	total(0),
+	maximum(0)
+{
+	for (auto& count : counts)
+	{
+		count.store(0, memory_order_relaxed);
+	}
+}
+
+
+// Counts a duration. Negative durations count as zero.
+void LatencyHistogram::record(Duration duration)
+{
+	uint64_t nanoseconds = duration.count() > 0 ? static_cast<uint64_t>(duration.count()) : 0;
+	counts[bucket(nanoseconds)].fetch_add(1, memory_order_relaxed);
+	total.fetch_add(nanoseconds, memory_order_relaxed);
+	uint64_t highest = maximum.load(memory_order_relaxed);
+	while (nanoseconds > highest && !maximum.compare_exchange_weak(highest, nanoseconds, memory_order_relaxed))
+	{
+	}
+}
+
+
+// Summarises everything recorded so far. Durations being recorded meanwhile may or may not be included.
+LatencyHistogram::Summary LatencyHistogram::summary() const
+{
+	array<uint64_t, BUCKETS> snapshot;
+	for (size_t n = 0; n < BUCKETS; n++)
+	{
+		snapshot[n] = counts[n].load(memory_order_relaxed);
+	}
+	return summarise(snapshot, total.load(memory_order_relaxed), maximum.load(memory_order_relaxed));
+}
+
+
+// Summarises everything recorded since the last take and empties the histogram, e.g. for periodic reports. Each
+// duration recorded meanwhile is counted in this report or the next.
+LatencyHistogram::Summary LatencyHistogram::take()
+{
+	array<uint64_t, BUCKETS> snapshot;
+	for (size_t n = 0; n < BUCKETS; n++)
+	{
+		snapshot[n] = counts[n].exchange(0, memory_order_relaxed);
+	}
+	return summarise(snapshot, total.exchange(0, memory_order_relaxed), maximum.exchange(0, memory_order_relaxed));
+}
+
+
+// Durations below eight nanoseconds have a bucket each. Above that, the bucket is the position of the top bit and the
+// three bits below it.
+size_t LatencyHistogram::bucket(uint64_t nanoseconds)
+{
+	if (nanoseconds < SUB_BUCKETS)
+	{
+		return static_cast<size_t>(nanoseconds);
+	}
+	unsigned top = 63;
+	while ((nanoseconds >> top) == 0)
+	{
+		top--;
+	}
+	return (top - 2) * SUB_BUCKETS + static_cast<size_t>((nanoseconds >> (top - 3)) & (SUB_BUCKETS - 1));
+}
+
+
+// The middle of the durations that fall in a bucket.
+uint64_t LatencyHistogram::bucket_value(size_t bucket)
+{
+	if (bucket < SUB_BUCKETS)
+	{
+		return bucket;
+	}
+	unsigned top = static_cast<unsigned>(bucket / SUB_BUCKETS) + 2;
+	uint64_t width = uint64_t(1) << (top - 3);
+	uint64_t lowest = (uint64_t(1) << top) + (bucket % SUB_BUCKETS) * width;
+	return lowest + width / 2;
+}
+
+
+LatencyHistogram::Summary LatencyHistogram::summarise(const array<uint64_t, BUCKETS>& counts, uint64_t total,
+	uint64_t maximum)
+{
+	Summary summary{};
+	for (auto count : counts)
+	{
+		summary.count += count;
+	}
+	if (summary.count == 0)
+	{
+		return summary;
+	}
+	summary.mean = total / summary.count;
+	summary.maximum = maximum;
+
+	// Walk the buckets until each percentile's share of the durations has been passed. A bucket's value never
+	// exceeds the largest duration recorded.
+	uint64_t* percentiles[] = { &summary.p50, &summary.p90, &summary.p99 };
+	const uint64_t shares[] = { 50, 90, 99 };
+	uint64_t seen = 0;
+	size_t next = 0;
+	for (size_t n = 0; n < BUCKETS && next < 3; n++)
+	{
+		seen += counts[n];
+		while (next < 3 && seen * 100 >= summary.count * shares[next])
+		{
+			*percentiles[next++] = min(bucket_value(n), maximum);
+		}
+	}
+	return summary;
+}
+
+
+void LatencyHistogram::write_heading(ostream& out)
+{
+	char line[128];
+	snprintf(line, sizeof(line), "%-16s %9s %8s %8s %8s %8s %8s (ms)\n", "", "count", "mean", "p50", "p90", "p99", "max");
+	out << line;
+}
+
+
+// Writes a line of the summary in milliseconds, under the heading.
+void LatencyHistogram::write(ostream& out, const char* name, const Summary& summary)
+{
+	auto ms = [](uint64_t nanoseconds) { return nanoseconds / 1e6; };
+	char line[128];
+	snprintf(line, sizeof(line), "%-16s %9llu %8.3f %8.3f %8.3f %8.3f %8.3f\n", name, (unsigned long long)summary.count,
+		ms(summary.mean), ms(summary.p50), ms(summary.p90), ms(summary.p99), ms(summary.maximum));
+	out << line;
+}
@@ -0,0 +1,294 @@
+#include "inputlog.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <thread>
+
+
+static_assert(sizeof(InputLog::Event) == 16, "InputLog::Event must not contain implicit padding");
+static_assert(sizeof(InputLog::Checkpoint) == 16 + sizeof(Chip8VM::State), "InputLog::Checkpoint must not contain padding");
+
+
+// Starts a new recording of the given program, which the caller loads into the VM with the same seed.
+void InputLog::start(const Chip8VM::Byte* data, size_t len, uint64_t seed)
+{
+	this->seed = seed;
+	rom_hash = hash_rom(data, len);
+	end = 0;
+	end_hash = 0;
+	events.clear();
+	checkpoints.clear();
+}
+
+
+// Records an event at the VM's current instruction count. Call it alongside the matching call on the VM.
+void InputLog::record(const Chip8VM& vm, Type type, Chip8VM::Key key)
+{
+	if (type != Type::TICK && key == Chip8VM::Key::NO_KEY)
+	{
+		return;
+	}
+	Event event{ vm.instructions, type, static_cast<uint8_t>(key), {} };
+	events.push_back(event);
+}
+
+
+// Records the VM's current state as a checkpoint. Segments between checkpoints can be verified independently.
+void InputLog::checkpoint(const Chip8VM& vm)
+{
+	checkpoints.emplace_back();
+	Checkpoint& checkpoint = checkpoints.back();
+	checkpoint.event = events.size();
+	checkpoint.hash = vm.hash();
+	vm.save(checkpoint.state);
+}
+
+
+// Discards the events after the first event_count, and any checkpoints after them, when the VM has been rewound.
+void InputLog::truncate(const Chip8VM& vm, size_t event_count)
+{
+	events.resize(min(event_count, events.size()));
+	while (!checkpoints.empty() &&
+		(checkpoints.back().event > events.size() || checkpoints.back().state.instructions > vm.instructions))
+	{
+		checkpoints.pop_back();
+	}
+}
+
+
+// Marks the end of the session.
+void InputLog::finish(const Chip8VM& vm)
+{
+	end = vm.instructions;
+	end_hash = vm.hash();
+}
+
+
+// Writes the log to a file. Integers are written in native byte order, as with Chip8VM::State.
+bool InputLog::save(const string& filename) const
+{
+	ofstream os(filename, ofstream::binary);
+	return save(os);
+}
+
+
+bool InputLog::save(ostream& os) const
+{
+	uint32_t header[] = { MAGIC, VERSION };
+	uint64_t fields[] = { seed, rom_hash, end, end_hash, events.size(), checkpoints.size() };
+	os.write((const char*)header, sizeof(header));
+	os.write((const char*)fields, sizeof(fields));
+	os.write((const char*)events.data(), events.size() * sizeof(Event));
+	os.write((const char*)checkpoints.data(), checkpoints.size() * sizeof(Checkpoint));
+	return os.good();
+}
+
+
+// Reads a log from a file, returning false if it can't be read, wasn't written by this version or is corrupt.
+bool InputLog::load(const string& filename)
+{
+	ifstream is(filename, ifstream::binary);
+	return load(is);
+}
+
+
+// Logs may come from anywhere, so the counts are checked against the size of the stream before anything is allocated,
+// and every event and checkpoint is checked before it can reach a VM.
+bool InputLog::load(istream& is)
+{
+	uint32_t header[2];
+	uint64_t fields[6];
+	if (!is.read((char*)header, sizeof(header)) || header[0] != MAGIC || header[1] != VERSION ||
+		!is.read((char*)fields, sizeof(fields)))
+	{
+		return false;
+	}
+
+	auto body = is.tellg();
+	is.seekg(0, is.end);
+	auto length = is.tellg();
+	is.seekg(body);
+	if (body < 0 || length < body || !is)
+	{
+		return false;
+	}
+	uint64_t remaining = static_cast<uint64_t>(length - body);
+	if (fields[4] > remaining / sizeof(Event) ||
+		fields[5] != (remaining - fields[4] * sizeof(Event)) / sizeof(Checkpoint) ||
+		remaining != fields[4] * sizeof(Event) + fields[5] * sizeof(Checkpoint))
+	{
+		return false;
+	}
+
+	seed = fields[0];
+	rom_hash = fields[1];
+	end = fields[2];
+	end_hash = fields[3];
+	events.resize(static_cast<size_t>(fields[4]));
+	checkpoints.resize(static_cast<size_t>(fields[5]));
+	if (!is.read((char*)events.data(), events.size() * sizeof(Event)) ||
+		!is.read((char*)checkpoints.data(), checkpoints.size() * sizeof(Checkpoint)))
+	{
+		return false;
+	}
+
+	auto is_valid_event = [](const Event& event) {
+		return event.type == Type::TICK || ((event.type == Type::KEY_DOWN || event.type == Type::KEY_UP) && event.key < 16);
+	};
+	auto is_valid_checkpoint = [&](const Checkpoint& checkpoint) {
+		return checkpoint.event <= events.size() && checkpoint.state.is_valid();
+	};
+	return all_of(events.begin(), events.end(), is_valid_event) &&
+		all_of(checkpoints.begin(), checkpoints.end(), is_valid_checkpoint);
+}
+
+
+// Returns a 64-bit FNV-1a hash of a program, used to check that a log is replayed against the program it recorded.
+uint64_t InputLog::hash_rom(const Chip8VM::Byte* data, size_t len)
+{
+	uint64_t h = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < len; i++)
+	{
+		h = (h ^ data[i]) * 0x100000001b3ull;
+	}
+	return h;
+}
+
+
+// Applies a recorded event to the VM.
+void InputLog::apply(Chip8VM& vm, const Event& event)
+{
+	switch (event.type)
+	{
+	case Type::KEY_DOWN:
+		vm.key_pressed(static_cast<Chip8VM::Key>(event.key));
+		break;
+	case Type::KEY_UP:
+		vm.key_released(static_cast<Chip8VM::Key>(event.key));
+		break;
+	case Type::TICK:
+		vm.tick();
+		break;
+	}
+}
+
+
+// Runs the VM until it has executed a given number of instructions. Returns false if the VM blocks first.
+bool run_to(Chip8VM& vm, uint64_t instructions)
+{
+	while (vm.instructions < instructions)
+	{
+		uint64_t before = vm.instructions;
+		uint64_t remaining = instructions - before;
+		vm.step(remaining > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(remaining));
+		if (vm.instructions == before)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+// Loads a program and replays a log against it as fast as possible. Returns false if the log doesn't match the program.
+bool replay(Chip8VM& vm, const InputLog& log, Chip8VM::Byte* data, size_t len, FrameCallback on_frame)
+{
+	if (InputLog::hash_rom(data, len) != log.rom_hash)
+	{
+		return false;
+	}
+	if (!vm.load(data, len, log.seed))
+	{
+		return false;
+	}
+	for (const auto& event : log.events)
+	{
+		if (!run_to(vm, event.instructions))
+		{
+			return false;
+		}
+		if (on_frame && event.type == InputLog::Type::TICK)
+		{
+			on_frame(vm);
+		}
+		InputLog::apply(vm, event);
+	}
+	return run_to(vm, log.end);
+}
+
+
+// Replays one segment of a log. Segment n runs from checkpoint n - 1 (or the start of the session) to checkpoint n
+// (or the end of the session), so there are checkpoints.size() + 1 segments and each can be replayed on its own.
+SegmentResult verify_segment(const InputLog& log, size_t segment, Chip8VM::Byte* data, size_t len)
+{
+	auto vm_handle = make_unique<Chip8VM>();
+	Chip8VM& vm = *vm_handle;
+	SegmentResult result{ 0, 0, false };
+
+	// Start from the previous checkpoint, which must itself be intact.
+	size_t first_event = 0;
+	if (segment == 0)
+	{
+		if (InputLog::hash_rom(data, len) != log.rom_hash || !vm.load(data, len, log.seed))
+		{
+			return result;
+		}
+	}
+	else
+	{
+		const InputLog::Checkpoint& start = log.checkpoints[segment - 1];
+		if (!vm.restore(start.state) || vm.hash() != start.hash)
+		{
+			return result;
+		}
+		first_event = static_cast<size_t>(start.event);
+	}
+	result.start = vm.instructions;
+
+	// Finish at the next checkpoint.
+	bool is_last = segment == log.checkpoints.size();
+	size_t last_event = is_last ? log.events.size() : static_cast<size_t>(log.checkpoints[segment].event);
+	result.end = is_last ? log.end : log.checkpoints[segment].state.instructions;
+	uint64_t expected = is_last ? log.end_hash : log.checkpoints[segment].hash;
+
+	for (size_t n = first_event; n < last_event && n < log.events.size(); n++)
+	{
+		if (!run_to(vm, log.events[n].instructions))
+		{
+			return result;
+		}
+		InputLog::apply(vm, log.events[n]);
+	}
+	result.matched = run_to(vm, result.end) && vm.hash() == expected;
+	return result;
+}
+
+
+// Verifies a whole log by replaying its segments concurrently, one per thread at a time. 0 threads means one per core.
+vector<SegmentResult> verify(const InputLog& log, Chip8VM::Byte* data, size_t len, unsigned threads)
+{
+	vector<SegmentResult> results(log.checkpoints.size() + 1);
+	atomic<size_t> next{ 0 };
+	auto worker = [&]() {
+		for (size_t n; (n = next++) < results.size(); )
+		{
+			results[n] = verify_segment(log, n, data, len);
+		}
+	};
+
+	unsigned thread_count = threads ? threads : max(1u, thread::hardware_concurrency());
+	thread_count = min<unsigned>(thread_count, static_cast<unsigned>(results.size()));
+	vector<thread> workers;
+	for (unsigned t = 1; t < thread_count; t++)
+	{
+		workers.emplace_back(worker);
+	}
+	worker();
+	for (auto& t : workers)
+	{
+		t.join();
+	}
+	return results;
+}
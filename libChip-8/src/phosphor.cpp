@@ -0,0 +1,106 @@
+#include "phosphor.hpp"
+
+#include <cstring>
+
+// SSE2 is always available on x64, and on x86 when the compiler has been told to use it.
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PHOSPHOR_SSE2
+#include <emmintrin.h>
+#endif
+
+
+Phosphor::Phosphor(uint8_t decay, const Palette& palette) :
+	decay(decay)
+{
+	set_palette(palette);
+	reset();
+}
+
+
+void Phosphor::reset()
+{
+	intensity.fill(0);
+}
+
+
+// Fades every pixel by the decay factor, then relights the pixels that are lit on the screen.
+void Phosphor::tick(const Chip8Screen& screen)
+{
+#ifdef PHOSPHOR_SSE2
+	// Sixteen pixels at a time: widen to 16 bits to multiply by the decay, narrow again, then OR in 0xff where the screen
+	// is lit. The lit mask is made by unpacking the row until each byte fills eight lanes, then testing one bit per lane.
+	const __m128i mask = _mm_set1_epi64x(0x0102040810204080ll);
+	const __m128i factor = _mm_set1_epi16(decay);
+	const __m128i zero = _mm_setzero_si128();
+	__m128i* pixels = reinterpret_cast<__m128i*>(intensity.data());
+	for (auto y = 0; y < HEIGHT; y++, pixels += 4)
+	{
+		__m128i bytes = _mm_set_epi64x(0, static_cast<long long>(screen.rows[y]));
+		__m128i pairs = _mm_unpacklo_epi8(bytes, bytes);
+		__m128i low_quads = _mm_unpacklo_epi16(pairs, pairs);
+		__m128i high_quads = _mm_unpackhi_epi16(pairs, pairs);
+
+		// The row's most significant byte holds the leftmost pixels, so the groups come out last first and each needs
+		// its two halves swapping.
+		__m128i groups[4] = {
+			_mm_unpackhi_epi32(high_quads, high_quads), _mm_unpacklo_epi32(high_quads, high_quads),
+			_mm_unpackhi_epi32(low_quads, low_quads), _mm_unpacklo_epi32(low_quads, low_quads) };
+		for (auto n = 0; n < 4; n++)
+		{
+			__m128i group = _mm_shuffle_epi32(groups[n], _MM_SHUFFLE(1, 0, 3, 2));
+			__m128i lit = _mm_cmpeq_epi8(_mm_and_si128(group, mask), mask);
+
+			__m128i old = _mm_load_si128(pixels + n);
+			__m128i low = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(old, zero), factor), 8);
+			__m128i high = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(old, zero), factor), 8);
+			_mm_store_si128(pixels + n, _mm_or_si128(_mm_packus_epi16(low, high), lit));
+		}
+	}
+#else
+	uint8_t* pixel = intensity.data();
+	for (auto y = 0; y < HEIGHT; y++)
+	{
+		uint64_t row = screen.rows[y];
+		for (auto x = 0; x < WIDTH; x++, pixel++, row <<= 1)
+		{
+			*pixel = (row >> 63) ? 0xff : static_cast<uint8_t>((*pixel * decay) >> 8);
+		}
+	}
+#endif
+}
+
+
+// Writes the blended frame as 64x32 RGBA8 pixels.
+void Phosphor::render(uint8_t* pixels, size_t pitch) const
+{
+	const uint8_t* level = intensity.data();
+	for (auto y = 0; y < HEIGHT; y++, pixels += pitch)
+	{
+		uint32_t line[WIDTH];
+		for (auto x = 0; x < WIDTH; x++)
+		{
+			line[x] = colours[level[x]];
+		}
+		memcpy(pixels, line, sizeof(line));
+		level += WIDTH;
+	}
+}
+
+
+// Mixes the palette's colours in proportion to each intensity, so that rendering is a table lookup per pixel.
+void Phosphor::set_palette(const Palette& palette)
+{
+	for (unsigned level = 0; level < colours.size(); level++)
+	{
+		uint8_t channels[4];
+		for (auto c = 0; c < 4; c++)
+		{
+			// RGBA8 is bytes red, green, blue and alpha, which sit at these shifts in an 0xAARRGGBB colour.
+			static const int SHIFTS[4] = { 16, 8, 0, 24 };
+			unsigned on = (palette.on >> SHIFTS[c]) & 0xff;
+			unsigned off = (palette.off >> SHIFTS[c]) & 0xff;
+			channels[c] = static_cast<uint8_t>((on * level + off * (255 - level) + 127) / 255);
+		}
+		memcpy(&colours[level], channels, sizeof(channels));
+	}
+}
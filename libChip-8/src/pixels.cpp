@@ -0,0 +1,302 @@
+#include "pixels.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CHIP8_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#endif
+
+// GCC and Clang only allow intrinsics in functions compiled for their instruction set, whereas MSVC always allows them.
+#if defined(CHIP8_X86) && defined(__GNUC__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+
+// A kernel expands the 64 pixels in a word, most significant bit first, into colours that are already in the output
+// format.
+using Kernel = void (*)(uint64_t bits, void* out, uint32_t off, uint32_t on);
+
+
+template <typename Pixel>
+static void expand_scalar(uint64_t bits, void* out, uint32_t off, uint32_t on)
+{
+	Pixel* pixel = static_cast<Pixel*>(out);
+	for (auto x = 0; x < 64; x++, bits <<= 1)
+	{
+		pixel[x] = static_cast<Pixel>((bits >> 63) ? on : off);
+	}
+}
+
+
+#ifdef CHIP8_X86
+
+// Each kernel broadcasts a group of bits to every lane, isolates one bit per lane with a mask, compares to turn the
+// bit into an all-ones or all-zeros lane, then uses that to select between the two colours.
+
+TARGET_SSE2 static void expand32_sse2(uint64_t bits, void* out, uint32_t off, uint32_t on)
+{
+	const __m128i mask = _mm_set_epi32(1, 2, 4, 8);
+	const __m128i lit_colour = _mm_set1_epi32(on);
+	const __m128i unlit_colour = _mm_set1_epi32(off);
+	__m128i* pixels = static_cast<__m128i*>(out);
+	for (auto n = 0; n < 16; n++)
+	{
+		__m128i group = _mm_set1_epi32(static_cast<int>(bits >> (60 - 4 * n)) & 0xf);
+		__m128i lit = _mm_cmpeq_epi32(_mm_and_si128(group, mask), mask);
+		_mm_storeu_si128(pixels + n, _mm_or_si128(_mm_and_si128(lit, lit_colour), _mm_andnot_si128(lit, unlit_colour)));
+	}
+}
+
+
+TARGET_SSE2 static void expand16_sse2(uint64_t bits, void* out, uint32_t off, uint32_t on)
+{
+	const __m128i mask = _mm_set_epi16(1, 2, 4, 8, 16, 32, 64, 128);
+	const __m128i lit_colour = _mm_set1_epi16(static_cast<short>(on));
+	const __m128i unlit_colour = _mm_set1_epi16(static_cast<short>(off));
+	__m128i* pixels = static_cast<__m128i*>(out);
+	for (auto n = 0; n < 8; n++)
+	{
+		__m128i group = _mm_set1_epi16(static_cast<short>((bits >> (56 - 8 * n)) & 0xff));
+		__m128i lit = _mm_cmpeq_epi16(_mm_and_si128(group, mask), mask);
+		_mm_storeu_si128(pixels + n, _mm_or_si128(_mm_and_si128(lit, lit_colour), _mm_andnot_si128(lit, unlit_colour)));
+	}
+}
+
+
+TARGET_SSE2 static void expand8_sse2(uint64_t bits, void* out, uint32_t off, uint32_t on)
+{
+	const uint64_t BYTES = 0x0101010101010101ull;
+	const __m128i mask = _mm_set1_epi64x(0x0102040810204080ll);		// 0x80 in the first byte, 0x01 in the eighth.
+	const __m128i lit_colour = _mm_set1_epi8(static_cast<char>(on));
+	const __m128i unlit_colour = _mm_set1_epi8(static_cast<char>(off));
+	__m128i* pixels = static_cast<__m128i*>(out);
+	for (auto n = 0; n < 4; n++)
+	{
+		uint64_t first = (bits >> (56 - 16 * n)) & 0xff;
+		uint64_t second = (bits >> (48 - 16 * n)) & 0xff;
+		__m128i group = _mm_set_epi64x(static_cast<long long>(second * BYTES), static_cast<long long>(first * BYTES));
+		__m128i lit = _mm_cmpeq_epi8(_mm_and_si128(group, mask), mask);
+		_mm_storeu_si128(pixels + n, _mm_or_si128(_mm_and_si128(lit, lit_colour), _mm_andnot_si128(lit, unlit_colour)));
+	}
+}
+
+
+TARGET_AVX2 static void expand32_avx2(uint64_t bits, void* out, uint32_t off, uint32_t on)
+{
+	const __m256i mask = _mm256_set_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+	const __m256i lit_colour = _mm256_set1_epi32(on);
+	const __m256i unlit_colour = _mm256_set1_epi32(off);
+	__m256i* pixels = static_cast<__m256i*>(out);
+	for (auto n = 0; n < 8; n++)
+	{
+		__m256i group = _mm256_set1_epi32(static_cast<int>(bits >> (56 - 8 * n)) & 0xff);
+		__m256i lit = _mm256_cmpeq_epi32(_mm256_and_si256(group, mask), mask);
+		_mm256_storeu_si256(pixels + n, _mm256_blendv_epi8(unlit_colour, lit_colour, lit));
+	}
+}
+
+
+TARGET_AVX2 static void expand16_avx2(uint64_t bits, void* out, uint32_t off, uint32_t on)
+{
+	const __m256i mask = _mm256_set_epi16(1, 2, 4, 8, 16, 32, 64, 128,
+		0x100, 0x200, 0x400, 0x800, 0x1000, 0x2000, 0x4000, static_cast<short>(0x8000));
+	const __m256i lit_colour = _mm256_set1_epi16(static_cast<short>(on));
+	const __m256i unlit_colour = _mm256_set1_epi16(static_cast<short>(off));
+	__m256i* pixels = static_cast<__m256i*>(out);
+	for (auto n = 0; n < 4; n++)
+	{
+		__m256i group = _mm256_set1_epi16(static_cast<short>((bits >> (48 - 16 * n)) & 0xffff));
+		__m256i lit = _mm256_cmpeq_epi16(_mm256_and_si256(group, mask), mask);
+		_mm256_storeu_si256(pixels + n, _mm256_blendv_epi8(unlit_colour, lit_colour, lit));
+	}
+}
+
+
+TARGET_AVX2 static void expand8_avx2(uint64_t bits, void* out, uint32_t off, uint32_t on)
+{
+	const uint64_t BYTES = 0x0101010101010101ull;
+	const __m256i mask = _mm256_set1_epi64x(0x0102040810204080ll);
+	const __m256i lit_colour = _mm256_set1_epi8(static_cast<char>(on));
+	const __m256i unlit_colour = _mm256_set1_epi8(static_cast<char>(off));
+	__m256i* pixels = static_cast<__m256i*>(out);
+	for (auto n = 0; n < 2; n++)
+	{
+		auto byte = [&](int i) { return static_cast<long long>(((bits >> (56 - 32 * n - 8 * i)) & 0xff) * BYTES); };
+		__m256i group = _mm256_set_epi64x(byte(3), byte(2), byte(1), byte(0));
+		__m256i lit = _mm256_cmpeq_epi8(_mm256_and_si256(group, mask), mask);
+		_mm256_storeu_si256(pixels + n, _mm256_blendv_epi8(unlit_colour, lit_colour, lit));
+	}
+}
+
+#endif
+
+
+size_t bytes_per_pixel(PixelFormat format)
+{
+	switch (format)
+	{
+	case PixelFormat::RGBA8:
+		return 4;
+	case PixelFormat::RGB565:
+		return 2;
+	default:
+		return 1;
+	}
+}
+
+
+SimdLevel supported_simd_level()
+{
+#if defined(CHIP8_X86) && defined(_MSC_VER)
+	static const SimdLevel level = []() {
+		int info[4];
+		__cpuid(info, 0);
+		int highest = info[0];
+		__cpuid(info, 1);
+		bool sse2 = (info[3] & (1 << 26)) != 0;
+		bool os_saves_avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+		bool avx2 = false;
+		if (highest >= 7 && os_saves_avx)
+		{
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+		}
+		return avx2 ? SimdLevel::AVX2 : sse2 ? SimdLevel::SSE2 : SimdLevel::SCALAR;
+	}();
+	return level;
+#elif defined(CHIP8_X86) && defined(__GNUC__)
+	static const SimdLevel level = []() {
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") ? SimdLevel::AVX2 : __builtin_cpu_supports("sse2") ? SimdLevel::SSE2 : SimdLevel::SCALAR;
+	}();
+	return level;
+#else
+	return SimdLevel::SCALAR;
+#endif
+}
+
+
+// Converts an 0xAARRGGBB colour to the given format, returning it in the low bits of the result.
+static uint32_t convert_colour(uint32_t argb, PixelFormat format)
+{
+	uint8_t a = static_cast<uint8_t>(argb >> 24);
+	uint8_t r = static_cast<uint8_t>(argb >> 16);
+	uint8_t g = static_cast<uint8_t>(argb >> 8);
+	uint8_t b = static_cast<uint8_t>(argb);
+	switch (format)
+	{
+	case PixelFormat::RGBA8:
+	{
+		uint8_t bytes[4] = { r, g, b, a };
+		uint32_t colour;
+		memcpy(&colour, bytes, sizeof(colour));
+		return colour;
+	}
+	case PixelFormat::RGB565:
+		return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+	default:
+		return (r * 77 + g * 150 + b * 29) >> 8;
+	}
+}
+
+
+static Kernel select_kernel(PixelFormat format, SimdLevel level)
+{
+#ifdef CHIP8_X86
+	if (level == SimdLevel::AVX2)
+	{
+		return format == PixelFormat::RGBA8 ? expand32_avx2 : format == PixelFormat::RGB565 ? expand16_avx2 : expand8_avx2;
+	}
+	if (level == SimdLevel::SSE2)
+	{
+		return format == PixelFormat::RGBA8 ? expand32_sse2 : format == PixelFormat::RGB565 ? expand16_sse2 : expand8_sse2;
+	}
+#endif
+	return format == PixelFormat::RGBA8 ? expand_scalar<uint32_t> : format == PixelFormat::RGB565 ? expand_scalar<uint16_t> : expand_scalar<uint8_t>;
+}
+
+
+// Returns word w of a row whose pixels have each been repeated scale times.
+static uint64_t scaled_word(uint64_t row, unsigned scale, unsigned w)
+{
+	if (scale == 1)
+	{
+		return row;
+	}
+	uint64_t word = 0;
+	uint64_t start = uint64_t(w) * 64;
+	for (uint64_t x = start / scale; x < 64 && x * scale < start + 64; x++)
+	{
+		if ((row << x) >> 63)
+		{
+			uint64_t from = max(x * scale, start) - start;
+			uint64_t to = min(x * scale + scale, start + 64) - start;
+			word |= (~0ull >> from) & (to == 64 ? ~0ull : ~(~0ull >> to));
+		}
+	}
+	return word;
+}
+
+
+void expand_pixels(const uint64_t* rows, size_t count, PixelFormat format, const Palette& palette, unsigned scale,
+	void* pixels, size_t pitch)
+{
+	expand_image(rows, 1, count, format, palette, scale, pixels, pitch, supported_simd_level());
+}
+
+
+void expand_pixels(const uint64_t* rows, size_t count, PixelFormat format, const Palette& palette, unsigned scale,
+	void* pixels, size_t pitch, SimdLevel level)
+{
+	expand_image(rows, 1, count, format, palette, scale, pixels, pitch, level);
+}
+
+
+void expand_image(const uint64_t* image, size_t words, size_t height, PixelFormat format, const Palette& palette,
+	unsigned scale, void* pixels, size_t pitch)
+{
+	expand_image(image, words, height, format, palette, scale, pixels, pitch, supported_simd_level());
+}
+
+
+void expand_image(const uint64_t* image, size_t words, size_t height, PixelFormat format, const Palette& palette,
+	unsigned scale, void* pixels, size_t pitch, SimdLevel level)
+{
+	if (scale == 0)
+	{
+		return;
+	}
+	Kernel kernel = select_kernel(format, min(level, supported_simd_level()));
+	uint32_t off = convert_colour(palette.off, format);
+	uint32_t on = convert_colour(palette.on, format);
+	size_t word_bytes = 64 * bytes_per_pixel(format);
+
+	// Expand the first line of each row, then copy it to make the rest.
+	uint8_t* line = static_cast<uint8_t*>(pixels);
+	for (size_t y = 0; y < height; y++)
+	{
+		const uint64_t* row = image + y * words;
+		uint8_t* first = line;
+		for (size_t k = 0; k < words; k++)
+		{
+			for (unsigned w = 0; w < scale; w++)
+			{
+				kernel(scaled_word(row[k], scale, w), first + (k * scale + w) * word_bytes, off, on);
+			}
+		}
+		line += pitch;
+		for (unsigned copy = 1; copy < scale; copy++, line += pitch)
+		{
+			memcpy(line, first, words * scale * word_bytes);
+		}
+	}
+}
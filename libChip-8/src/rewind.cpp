@@ -0,0 +1,164 @@
+#include "rewind.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+static_assert(sizeof(Chip8VM::State) <= 0xffff, "Delta runs must fit in 16 bits");
+
+
+// Creates a rewind buffer holding at least capacity frames, with a keyframe every interval frames.
+RewindBuffer::RewindBuffer(size_t capacity, size_t interval) :
+	interval(interval ? interval : 1),
+	count(0),
+	first(0)
+{
+	// The capacity is rounded up to a whole number of keyframe intervals so that a keyframe and its deltas wrap together.
+	size_t groups = (capacity + this->interval - 1) / this->interval;
+	slots.resize((groups ? groups : 1) * this->interval);
+}
+
+
+// Records the VM's state as the next frame.
+void RewindBuffer::push(const Chip8VM& vm)
+{
+	vector<Byte>& slot = slots[count % slots.size()];
+	if (count % interval == 0)
+	{
+		vm.save(keyframe);
+		auto bytes = reinterpret_cast<const Byte*>(&keyframe);
+		slot.assign(bytes, bytes + sizeof(keyframe));
+	}
+	else
+	{
+		Chip8VM::State state;
+		vm.save(state);
+		encode_delta(reinterpret_cast<const Byte*>(&state), reinterpret_cast<const Byte*>(&keyframe), sizeof(state), slot);
+	}
+	++count;
+
+	// Once the buffer wraps, the group whose keyframe was overwritten can no longer be decoded.
+	if (count > slots.size())
+	{
+		uint64_t overwritten = count - slots.size();
+		first = max(first, (overwritten + interval - 1) / interval * interval);
+	}
+}
+
+
+// Restores the VM to a recorded frame, leaving the history untouched.
+bool RewindBuffer::seek(uint64_t frame, Chip8VM& vm) const
+{
+	Chip8VM::State state;
+	return decode(frame, state) && vm.restore(state);
+}
+
+
+// Restores the VM to a recorded frame and discards every later frame, so that recording continues from there. Frames
+// are numbered from 0 by push(), so after rewinding to frame n the next push() records frame n + 1.
+bool RewindBuffer::rewind(uint64_t frame, Chip8VM& vm)
+{
+	if (!seek(frame, vm))
+	{
+		return false;
+	}
+	uint64_t key = frame - frame % interval;
+	memcpy(&keyframe, slots[key % slots.size()].data(), sizeof(keyframe));
+	count = frame + 1;
+	return true;
+}
+
+
+// Forgets every recorded frame.
+void RewindBuffer::clear()
+{
+	count = 0;
+	first = 0;
+}
+
+
+// Returns the number of bytes used to hold the recorded frames.
+size_t RewindBuffer::bytes() const
+{
+	size_t total = 0;
+	for (const auto& slot : slots)
+	{
+		total += slot.size();
+	}
+	return total;
+}
+
+
+// Reconstructs the state of a recorded frame from its keyframe and delta.
+bool RewindBuffer::decode(uint64_t frame, Chip8VM::State& state) const
+{
+	if (empty() || frame < oldest() || frame > newest())
+	{
+		return false;
+	}
+	uint64_t key = frame - frame % interval;
+	memcpy(&state, slots[key % slots.size()].data(), sizeof(state));
+	if (frame != key)
+	{
+		apply_delta(slots[frame % slots.size()], reinterpret_cast<Byte*>(&state));
+	}
+	return true;
+}
+
+
+// Encodes current XOR key as a series of runs. Each run is a 16-bit count of unchanged bytes, a 16-bit count of
+// changed bytes, then the changed bytes XORed with the keyframe. Unchanged stretches are skipped 8 bytes at a time.
+void RewindBuffer::encode_delta(const Byte* current, const Byte* key, size_t len, vector<Byte>& out)
+{
+	out.clear();
+	size_t pos = 0;
+	while (pos < len)
+	{
+		size_t start = pos;
+		while (pos + 8 <= len && memcmp(current + pos, key + pos, 8) == 0)
+		{
+			pos += 8;
+		}
+		while (pos < len && current[pos] == key[pos])
+		{
+			pos++;
+		}
+		if (pos == len)
+		{
+			break;
+		}
+		size_t skip = pos - start;
+		size_t changed = pos;
+		while (changed < len && changed - pos < 0xffff && current[changed] != key[changed])
+		{
+			changed++;
+		}
+		size_t run = changed - pos;
+		Byte header[] = {
+			static_cast<Byte>(skip), static_cast<Byte>(skip >> 8),
+			static_cast<Byte>(run), static_cast<Byte>(run >> 8)
+		};
+		out.insert(out.end(), header, header + sizeof(header));
+		for (; pos < changed; pos++)
+		{
+			out.push_back(current[pos] ^ key[pos]);
+		}
+	}
+}
+
+
+// XORs an encoded delta into a copy of its keyframe.
+void RewindBuffer::apply_delta(const vector<Byte>& delta, Byte* state)
+{
+	size_t pos = 0;
+	for (size_t i = 0; i + 4 <= delta.size(); )
+	{
+		pos += delta[i] | (delta[i + 1] << 8);
+		size_t run = delta[i + 2] | (delta[i + 3] << 8);
+		i += 4;
+		for (size_t n = 0; n < run; n++)
+		{
+			state[pos++] ^= delta[i++];
+		}
+	}
+}
@@ -0,0 +1,79 @@
+#include "scheduler.hpp"
+
+#include <algorithm>
+
+
+static const uint64_t NANOSECONDS = 1000000000;
+
+const Scheduler::Clock::duration Scheduler::MAXIMUM_LAG = chrono::milliseconds(250);
+
+
+Scheduler::Scheduler(uint32_t instructions_per_second) :
+	instructions_per_second(instructions_per_second ? instructions_per_second : DEFAULT_RATE),
+	elapsed(0),
+	executed(0),
+	ticked(0),
+	total_instructions(0),
+	total_ticks(0)
+{
+}
+
+
+// Runs the instructions and ticks that fall within the host time that has elapsed since the last advance, calling
+// step() for the instructions between each tick and the next.
+void Scheduler::advance(Clock::duration host_elapsed, const TickFunction& tick, const StepFunction& step)
+{
+	auto lag = min(max(host_elapsed, Clock::duration::zero()), MAXIMUM_LAG);
+	elapsed += static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(lag).count());
+
+	auto run = [&](uint64_t target) {
+		if (target > executed)
+		{
+			step(static_cast<uint32_t>(target - executed));
+			total_instructions += target - executed;
+			executed = target;
+		}
+	};
+
+	uint64_t tick_target = elapsed * TIMER_HZ / NANOSECONDS;
+	while (ticked < tick_target)
+	{
+		// Tick k happens k / 60 seconds after the origin, after instruction k * rate / 60.
+		run((ticked + 1) * instructions_per_second / TIMER_HZ);
+		tick();
+		ticked++;
+		total_ticks++;
+
+		// A whole second is exactly rate instructions and 60 ticks, so the origin can move on without rounding.
+		if (ticked == TIMER_HZ)
+		{
+			elapsed -= NANOSECONDS;
+			executed -= instructions_per_second;
+			ticked = 0;
+			tick_target -= TIMER_HZ;
+		}
+	}
+	run(instruction_at(elapsed));
+}
+
+
+// How long until the next tick is due, e.g. for the host to sleep.
+Scheduler::Clock::duration Scheduler::until_tick() const
+{
+	uint64_t next = ((ticked + 1) * NANOSECONDS + TIMER_HZ - 1) / TIMER_HZ;
+	return chrono::duration_cast<Clock::duration>(chrono::nanoseconds(next - elapsed));
+}
+
+
+// Changes the CPU's speed from now on. The timers carry on as before.
+void Scheduler::set_rate(uint32_t instructions_per_second)
+{
+	this->instructions_per_second = instructions_per_second ? instructions_per_second : DEFAULT_RATE;
+	executed = instruction_at(elapsed);
+}
+
+
+uint64_t Scheduler::instruction_at(uint64_t nanoseconds) const
+{
+	return nanoseconds * instructions_per_second / NANOSECONDS;
+}
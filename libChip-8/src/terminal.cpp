@@ -0,0 +1,92 @@
+#include "terminal.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+
+TerminalRenderer::TerminalRenderer(Mode mode, unsigned top, unsigned left) :
+	mode(mode),
+	top(top ? top : 1),
+	left(left ? left : 1),
+	cell_width(mode == Mode::BRAILLE ? 2 : 1),
+	cell_height(mode == Mode::BRAILLE ? 4 : 2)
+{
+	cells.resize(columns() * rows());
+	invalidate();
+}
+
+
+// Forgets what the terminal shows, so that the next render redraws every cell.
+void TerminalRenderer::invalidate()
+{
+	fill(cells.begin(), cells.end(), static_cast<uint16_t>(UNKNOWN));
+}
+
+
+// Appends the escape sequences and characters that bring the terminal up to date with the screen, returning the
+// number of cells that were redrawn. The output string's storage is reused, so it can be kept from frame to frame.
+size_t TerminalRenderer::render(const Chip8Screen& screen, string& out)
+{
+	size_t changed = 0;
+	for (unsigned row = 0; row < rows(); row++)
+	{
+		// The cursor is only moved when the next changed cell doesn't follow the last one drawn.
+		bool cursor_here = false;
+		for (unsigned column = 0; column < columns(); column++)
+		{
+			uint16_t& cell = cells[row * columns() + column];
+			uint16_t now = pattern(screen, column, row);
+			if (now == cell)
+			{
+				cursor_here = false;
+				continue;
+			}
+			if (!cursor_here)
+			{
+				char move[24];
+				snprintf(move, sizeof(move), "\x1b[%u;%uH", top + row, left + column);
+				out += move;
+				cursor_here = true;
+			}
+			append_character(now, mode, out);
+			cell = now;
+			changed++;
+		}
+	}
+	return changed;
+}
+
+
+// The pixels in a cell. Braille patterns number their dots down the left column then down the right, with the bottom
+// row added later as dots 7 and 8, and the pattern's bits follow that numbering. Half blocks are top then bottom.
+uint16_t TerminalRenderer::pattern(const Chip8Screen& screen, unsigned column, unsigned row) const
+{
+	auto pixel = [&](unsigned dx, unsigned dy) -> uint16_t {
+		unsigned x = column * cell_width + dx;
+		unsigned y = row * cell_height + dy;
+		return static_cast<uint16_t>((screen.rows[y] >> (63 - x)) & 1);
+	};
+
+	if (mode == Mode::BRAILLE)
+	{
+		return pixel(0, 0) | pixel(0, 1) << 1 | pixel(0, 2) << 2 | pixel(1, 0) << 3 |
+			pixel(1, 1) << 4 | pixel(1, 2) << 5 | pixel(0, 3) << 6 | pixel(1, 3) << 7;
+	}
+	return pixel(0, 0) | pixel(0, 1) << 1;
+}
+
+
+// Appends a cell's character in UTF-8.
+void TerminalRenderer::append_character(uint16_t pattern, Mode mode, string& out)
+{
+	static const uint16_t HALF_BLOCKS[4] = { 0x0020, 0x2580, 0x2584, 0x2588 };		// Space, upper, lower and full block.
+	uint16_t code = mode == Mode::BRAILLE ? 0x2800 + pattern : HALF_BLOCKS[pattern & 3];
+	if (code < 0x80)
+	{
+		out += static_cast<char>(code);
+		return;
+	}
+	out += static_cast<char>(0xe0 | (code >> 12));
+	out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+	out += static_cast<char>(0x80 | (code & 0x3f));
+}
@@ -0,0 +1,174 @@
+#include "upscale.hpp"
+
+#include <array>
+
+
+// The pixels surrounding a word of pixels E:
+//
+//     A B C
+//     D E F
+//     G H I
+//
+// Each member holds one neighbour of all 64 pixels in the word, so the filters' comparisons become XORs.
+struct Neighbourhood
+{
+	uint64_t a, b, c, d, e, f, g, h, i;
+};
+
+
+// A word of pixels shifted one pixel right, so that each bit holds its left-hand neighbour.
+static inline uint64_t left_of(const uint64_t* row, size_t k)
+{
+	return (row[k] >> 1) | (k ? row[k - 1] << 63 : row[k] & 0x8000000000000000ull);
+}
+
+
+// A word of pixels shifted one pixel left, so that each bit holds its right-hand neighbour.
+static inline uint64_t right_of(const uint64_t* row, size_t words, size_t k)
+{
+	return (row[k] << 1) | (k + 1 < words ? row[k + 1] >> 63 : row[k] & 1);
+}
+
+
+static inline Neighbourhood neighbourhood(const uint64_t* in, size_t words, size_t height, size_t y, size_t k)
+{
+	const uint64_t* above = in + (y ? y - 1 : 0) * words;
+	const uint64_t* row = in + y * words;
+	const uint64_t* below = in + (y + 1 < height ? y + 1 : y) * words;
+	return {
+		left_of(above, k), above[k], right_of(above, words, k),
+		left_of(row, k), row[k], right_of(row, words, k),
+		left_of(below, k), below[k], right_of(below, words, k)
+	};
+}
+
+
+// Chooses a where the condition is set and b elsewhere.
+static inline uint64_t select(uint64_t condition, uint64_t a, uint64_t b)
+{
+	return (condition & a) | (~condition & b);
+}
+
+
+// Spreads 32 bits out to the even bits of a 64-bit word.
+static inline uint64_t spread2(uint64_t x)
+{
+	x &= 0xffffffff;
+	x = (x | (x << 16)) & 0x0000ffff0000ffffull;
+	x = (x | (x << 8)) & 0x00ff00ff00ff00ffull;
+	x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0full;
+	x = (x | (x << 2)) & 0x3333333333333333ull;
+	x = (x | (x << 1)) & 0x5555555555555555ull;
+	return x;
+}
+
+
+// Interleaves the pixels of two words into two words, alternating between them.
+static inline void interleave2(uint64_t p, uint64_t q, uint64_t* out)
+{
+	out[0] = (spread2(p >> 32) << 1) | spread2(q >> 32);
+	out[1] = (spread2(p) << 1) | spread2(q);
+}
+
+
+// Spreads the 8 bits of a byte out to every third bit.
+static const array<uint32_t, 256> spread3 = []() {
+	array<uint32_t, 256> table;
+	for (uint32_t byte = 0; byte < table.size(); byte++)
+	{
+		uint32_t spread = 0;
+		for (auto bit = 0; bit < 8; bit++)
+		{
+			spread |= ((byte >> bit) & 1) << (3 * bit);
+		}
+		table[byte] = spread;
+	}
+	return table;
+}();
+
+
+// Interleaves the pixels of three words into three words, taking a pixel from each in turn.
+static inline void interleave3(uint64_t p, uint64_t q, uint64_t r, uint64_t* out)
+{
+	// Each byte of the inputs makes 24 bits of output, which are packed most significant first. The eighth byte's bits
+	// complete the third word.
+	uint64_t word = 0;
+	unsigned used = 0;
+	for (auto shift = 56; shift >= 0; shift -= 8)
+	{
+		uint64_t bits = (uint64_t(spread3[(p >> shift) & 0xff]) << 2) | (uint64_t(spread3[(q >> shift) & 0xff]) << 1)
+			| spread3[(r >> shift) & 0xff];
+		if (used + 24 <= 64)
+		{
+			word |= bits << (64 - used - 24);
+			used += 24;
+		}
+		else
+		{
+			unsigned spill = used + 24 - 64;
+			*out++ = word | (bits >> spill);
+			word = bits << (64 - spill);
+			used = spill;
+		}
+	}
+	*out = word;
+}
+
+
+void scale2x(const uint64_t* in, size_t words, size_t height, uint64_t* out)
+{
+	size_t out_words = words * 2;
+	for (size_t y = 0; y < height; y++)
+	{
+		uint64_t* top = out + 2 * y * out_words;
+		uint64_t* bottom = top + out_words;
+		for (size_t k = 0; k < words; k++)
+		{
+			Neighbourhood n = neighbourhood(in, words, height, y, k);
+
+			// Pixels only change where B != H and D != F, and then take the colour of a matching pair of neighbours.
+			uint64_t edge = (n.b ^ n.h) & (n.d ^ n.f);
+			uint64_t e0 = select(edge & ~(n.d ^ n.b), n.d, n.e);
+			uint64_t e1 = select(edge & ~(n.b ^ n.f), n.f, n.e);
+			uint64_t e2 = select(edge & ~(n.d ^ n.h), n.d, n.e);
+			uint64_t e3 = select(edge & ~(n.h ^ n.f), n.f, n.e);
+
+			interleave2(e0, e1, top + 2 * k);
+			interleave2(e2, e3, bottom + 2 * k);
+		}
+	}
+}
+
+
+void scale3x(const uint64_t* in, size_t words, size_t height, uint64_t* out)
+{
+	size_t out_words = words * 3;
+	for (size_t y = 0; y < height; y++)
+	{
+		uint64_t* top = out + 3 * y * out_words;
+		uint64_t* middle = top + out_words;
+		uint64_t* bottom = middle + out_words;
+		for (size_t k = 0; k < words; k++)
+		{
+			Neighbourhood n = neighbourhood(in, words, height, y, k);
+
+			uint64_t edge = (n.b ^ n.h) & (n.d ^ n.f);
+			uint64_t db = edge & ~(n.d ^ n.b);
+			uint64_t bf = edge & ~(n.b ^ n.f);
+			uint64_t dh = edge & ~(n.d ^ n.h);
+			uint64_t hf = edge & ~(n.h ^ n.f);
+			uint64_t e0 = select(db, n.d, n.e);
+			uint64_t e1 = select((db & (n.e ^ n.c)) | (bf & (n.e ^ n.a)), n.b, n.e);
+			uint64_t e2 = select(bf, n.f, n.e);
+			uint64_t e3 = select((db & (n.e ^ n.g)) | (dh & (n.e ^ n.a)), n.d, n.e);
+			uint64_t e5 = select((bf & (n.e ^ n.i)) | (hf & (n.e ^ n.c)), n.f, n.e);
+			uint64_t e6 = select(dh, n.d, n.e);
+			uint64_t e7 = select((dh & (n.e ^ n.i)) | (hf & (n.e ^ n.g)), n.h, n.e);
+			uint64_t e8 = select(hf, n.f, n.e);
+
+			interleave3(e0, e1, e2, top + 3 * k);
+			interleave3(e3, n.e, e5, middle + 3 * k);
+			interleave3(e6, e7, e8, bottom + 3 * k);
+		}
+	}
+}
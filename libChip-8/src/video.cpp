@@ -0,0 +1,113 @@
+#include "video.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+
+// A grey whose luminance, as the GRAY8 kernel calculates it, is exactly the given value.
+static uint32_t grey(int value)
+{
+	uint32_t v = static_cast<uint32_t>(max(0, min(255, value)));
+	return 0xff000000 | (v << 16) | (v << 8) | v;
+}
+
+
+// Converts an 0xAARRGGBB colour to limited range BT.601 YUV, which is what Y4M readers assume.
+static void to_yuv(uint32_t argb, int yuv[3])
+{
+	int r = (argb >> 16) & 0xff;
+	int g = (argb >> 8) & 0xff;
+	int b = argb & 0xff;
+	yuv[0] = 16 + ((66 * r + 129 * g + 25 * b + 128) >> 8);
+	yuv[1] = 128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8);
+	yuv[2] = 128 + ((112 * r - 94 * g - 18 * b + 128) >> 8);
+}
+
+
+VideoWriter::VideoWriter(ostream& out, Format format, unsigned scale, const Palette& palette, unsigned fps,
+	ostream* timestamps) :
+	out(out),
+	timestamps(timestamps),
+	format(format),
+	scale(scale ? scale : 1),
+	fps(fps ? fps : 60),
+	frame_count(0),
+	written_count(0)
+{
+	size_t pixels = size_t(width()) * height();
+	if (format == Format::Y4M)
+	{
+		int off[3], on[3];
+		to_yuv(palette.off, off);
+		to_yuv(palette.on, on);
+		for (auto plane = 0; plane < 3; plane++)
+		{
+			planes[plane] = Palette(grey(off[plane]), grey(on[plane]));
+		}
+		frame.resize(pixels * 3);
+
+		char header[80];
+		snprintf(header, sizeof(header), "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C444\n", width(), height(), this->fps);
+		out << header;
+	}
+	else
+	{
+		planes[0] = palette;
+		frame.resize(pixels * 4);
+	}
+
+	if (timestamps)
+	{
+		*timestamps << "# timecode format v2\n";
+	}
+}
+
+
+// Offers the next frame. It's expanded only if it differs from the last one, and written unless it's the same and
+// only changes are being written.
+void VideoWriter::write(const Chip8Screen& screen)
+{
+	bool changed = frame_count == 0 || screen.rows != last;
+	if (changed)
+	{
+		last = screen.rows;
+		render(screen);
+	}
+
+	if (changed || timestamps == nullptr)
+	{
+		if (format == Format::Y4M)
+		{
+			out << "FRAME\n";
+		}
+		out.write(reinterpret_cast<const char*>(frame.data()), frame.size());
+		++written_count;
+
+		if (timestamps)
+		{
+			char line[32];
+			snprintf(line, sizeof(line), "%.3f\n", frame_count * 1000.0 / fps);
+			*timestamps << line;
+		}
+	}
+	++frame_count;
+}
+
+
+void VideoWriter::render(const Chip8Screen& screen)
+{
+	if (format == Format::Y4M)
+	{
+		size_t plane_size = frame.size() / 3;
+		for (auto plane = 0; plane < 3; plane++)
+		{
+			expand_pixels(screen.rows.data(), screen.rows.size(), PixelFormat::GRAY8, planes[plane], scale,
+				&frame[plane * plane_size], width());
+		}
+	}
+	else
+	{
+		expand_pixels(screen.rows.data(), screen.rows.size(), PixelFormat::RGBA8, planes[0], scale, frame.data(),
+			width() * 4);
+	}
+}
@@ -0,0 +1,224 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <libChip-8/include/chip8vm.hpp>
+#include <libChip-8/include/gif.hpp>
+#include <libChip-8/include/inputlog.hpp>
+#include <libChip-8/include/terminal.hpp>
+
+
+using namespace std;
+
+enum { SUCCEEDED, FAILED, USAGE };
+
+
+bool read_file(const string& filename, vector<Chip8VM::Byte>& buffer)
+{
+	ifstream is(filename, ifstream::binary | ios::ate);
+	if (!is)
+	{
+		return false;
+	}
+	buffer.resize(static_cast<size_t>(is.tellg()));
+	is.seekg(0, is.beg);
+	return static_cast<bool>(is.read((char*)buffer.data(), buffer.size()));
+}
+
+
+// Replays the log's segments in parallel, reporting any whose end state doesn't match the recording.
+int verify_log(const InputLog& log, vector<Chip8VM::Byte>& rom, unsigned threads)
+{
+	auto start = chrono::steady_clock::now();
+	auto results = verify(log, rom.data(), rom.size(), threads);
+	auto finish = chrono::steady_clock::now();
+
+	size_t failures = 0;
+	for (size_t n = 0; n < results.size(); n++)
+	{
+		if (!results[n].matched)
+		{
+			cerr << "Segment " << n << " (instructions " << results[n].start << " to " << results[n].end << ") diverged\n";
+			failures++;
+		}
+	}
+
+	char line[80];
+	snprintf(line, sizeof(line), "%zu/%zu segments verified in %.3f ms", results.size() - failures, results.size(),
+		chrono::duration<double, milli>(finish - start).count());
+	cout << line << endl;
+
+	return failures ? FAILED : SUCCEEDED;
+}
+
+
+int main(int argc, char* argv[])
+{
+	bool verifying = false;
+	unsigned threads = 0;
+	string gif_filename;
+	unsigned scale = 1;
+	bool watching = false;
+	auto terminal_mode = TerminalRenderer::Mode::BRAILLE;
+	vector<string> filenames;
+	try
+	{
+		for (auto i = 1; i < argc; i++)
+		{
+			string arg = argv[i];
+			if (arg == "--verify")
+			{
+				verifying = true;
+			}
+			else if (arg == "--threads" && i + 1 < argc)
+			{
+				threads = stoul(argv[++i]);
+			}
+			else if (arg == "--gif" && i + 1 < argc)
+			{
+				gif_filename = argv[++i];
+			}
+			else if (arg == "--scale" && i + 1 < argc)
+			{
+				scale = stoul(argv[++i]);
+			}
+			else if (arg == "--watch")
+			{
+				watching = true;
+			}
+			else if (arg == "--blocks")
+			{
+				terminal_mode = TerminalRenderer::Mode::HALF_BLOCK;
+			}
+			else
+			{
+				filenames.push_back(arg);
+			}
+		}
+	}
+	catch (const logic_error&)
+	{
+		// A malformed number.
+		filenames.clear();
+	}
+
+	if (filenames.size() != 2)
+	{
+		cerr << "Usage: " << argv[0] << " [--verify [--threads <n>] | [--gif <file> [--scale <n>]] [--watch [--blocks]]] <rom> <log>\n";
+		return USAGE;
+	}
+
+	vector<Chip8VM::Byte> rom;
+	if (!read_file(filenames[0], rom))
+	{
+		cerr << "Unable to read ROM " << filenames[0] << endl;
+		return FAILED;
+	}
+
+	if (rom.size() > Chip8VM::MAXIMUM_PROGRAM_SIZE)
+	{
+		cerr << "ROM " << filenames[0] << " is too large to load" << endl;
+		return FAILED;
+	}
+
+	InputLog log;
+	if (!log.load(filenames[1]))
+	{
+		cerr << "Unable to read input log " << filenames[1] << endl;
+		return FAILED;
+	}
+
+	if (InputLog::hash_rom(rom.data(), rom.size()) != log.rom_hash)
+	{
+		cerr << "The log does not match the ROM" << endl;
+		return FAILED;
+	}
+
+	if (verifying)
+	{
+		return verify_log(log, rom, threads);
+	}
+
+	auto vm_handle = make_unique<Chip8VM>();
+	Chip8VM& vm = *vm_handle;
+
+	// Optionally capture the replay as an animated GIF.
+	ofstream gif_file;
+	unique_ptr<GifWriter> gif;
+	FrameCallback on_frame;
+	if (!gif_filename.empty())
+	{
+		gif_file.open(gif_filename, ofstream::binary);
+		if (!gif_file)
+		{
+			cerr << "Unable to write " << gif_filename << endl;
+			return FAILED;
+		}
+		gif = make_unique<GifWriter>(gif_file, scale);
+		on_frame = [&](const Chip8VM& vm) { gif->write(vm.io.screen); };
+	}
+
+	// And/or watch it on the terminal in real time, sending only the characters that change.
+	TerminalRenderer terminal(terminal_mode);
+	string text;
+	auto next_frame = chrono::steady_clock::now();
+	if (watching)
+	{
+		cout << "\x1b[2J\x1b[?25l";
+		FrameCallback capture = on_frame;
+		on_frame = [&, capture](const Chip8VM& vm) {
+			if (capture)
+			{
+				capture(vm);
+			}
+			text.clear();
+			if (terminal.render(vm.io.screen, text))
+			{
+				cout << text << flush;
+			}
+			next_frame += chrono::microseconds(1000000 / 60);
+			this_thread::sleep_until(next_frame);
+		};
+	}
+
+	auto start = chrono::steady_clock::now();
+	bool replayed = replay(vm, log, rom.data(), rom.size(), on_frame);
+	auto finish = chrono::steady_clock::now();
+	if (gif)
+	{
+		gif->write(vm.io.screen);
+		gif->finish();
+	}
+	if (watching)
+	{
+		text.clear();
+		terminal.render(vm.io.screen, text);
+		cout << text << "\x1b[" << terminal.rows() + 1 << ";1H\x1b[?25h" << flush;
+	}
+
+	if (!replayed)
+	{
+		cerr << "The VM blocked waiting for a key at instruction " << vm.instructions
+			<< ", before the log's next event" << endl;
+		return FAILED;
+	}
+
+	char line[64];
+	snprintf(line, sizeof(line), "%016llx\t%llu\t%.3f", (unsigned long long)vm.hash(), (unsigned long long)vm.instructions,
+		chrono::duration<double, milli>(finish - start).count());
+	cout << line << endl;
+
+	if (vm.hash() != log.end_hash)
+	{
+		snprintf(line, sizeof(line), "%016llx", (unsigned long long)log.end_hash);
+		cerr << "The replay diverged from the recording, which ended with hash " << line << endl;
+		return FAILED;
+	}
+	return SUCCEEDED;
+}
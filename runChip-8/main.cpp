@@ -1,10 +1,29 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
 #include <SDL.h>
 
+#include <libChip-8/include/audio.hpp>
 #include <libChip-8/include/chip8vm.hpp>
+#include <libChip-8/include/handoff.hpp>
+#include <libChip-8/include/histogram.hpp>
+#include <libChip-8/include/inputlog.hpp>
+#include <libChip-8/include/phosphor.hpp>
+#include <libChip-8/include/pixels.hpp>
+#include <libChip-8/include/rewind.hpp>
+#include <libChip-8/include/scheduler.hpp>
 
 
 using namespace std;
@@ -14,25 +33,185 @@ const int SCALING = 16;
 const int SCREEN_WIDTH = Chip8VM::SCREEN_WIDTH * SCALING;
 const int SCREEN_HEIGHT = Chip8VM::SCREEN_HEIGHT * SCALING;
 
+// Green on dark grey. RGBA8 pixels are bytes R, G, B, A, which SDL calls ABGR8888 on little-endian machines.
+const Palette PALETTE(0xff0f0f0f, 0xff00ff00);
+const Uint32 TEXTURE_FORMAT = SDL_BYTEORDER == SDL_LIL_ENDIAN ? SDL_PIXELFORMAT_ABGR8888 : SDL_PIXELFORMAT_RGBA8888;
+
+// How often the screen is handed to the UI thread while fast-forwarding. Frames in between aren't drawn.
+const auto DISPLAY_INTERVAL = chrono::microseconds(1000000 / 60);
+
+// Uncapped fast-forwarding runs ticks back to back for this long before checking for commands.
+const auto TURBO_SLICE = chrono::milliseconds(2);
+
+// While the VM is idle the UI thread sleeps until an event arrives, including the one that the emulation thread posts
+// with each screen. It wakes at least this often regardless.
+const Uint32 IDLE_TIMEOUT_MS = 500;
+
+// How often --stats reports on the interval since its last report.
+const auto STATS_INTERVAL = chrono::seconds(10);
+
+// Frames between checkpoints when recording.
+const int CHECKPOINT_INTERVAL = 60 * 60;
+
+// The buzzer's samples per audio callback, and the most that may wait in the queue before ticks' samples are dropped.
+// Together they bound the delay between the sound timer being set and the beep being heard.
+const Uint16 AUDIO_BUFFER_SAMPLES = 512;
+const size_t MAXIMUM_QUEUED_SAMPLES = 4096;
+
 enum { SUCCEEDED, FAILED, USAGE };
 
 // A unique pointer with a custom destructor, used as a handle for SDL objects.
 template<typename C>
 using handle = std::unique_ptr<C, void(*)(C*)>;
 
+// Audio samples from the emulation thread to the audio callback.
+using SampleQueue = SpscQueue<int16_t, 8192>;
+
+// What the UI thread asks of the emulation thread.
+struct Command
+{
+	enum class Type : uint8_t { KEY_DOWN, KEY_UP, SAVE_STATE, LOAD_STATE, REWIND_START, REWIND_STOP, TURBO, QUIT };
+
+	Type type;
+	Chip8VM::Key key;					// The key, for KEY_DOWN and KEY_UP.
+	Scheduler::Clock::time_point time;	// When the event that caused it happened.
+};
+
+// A screen handed from the emulation thread to the UI thread, with the time of the key press it last responded to.
+struct Frame
+{
+	Chip8Screen screen;
+	uint64_t responses;						// Key presses that the screen has changed in response to so far.
+	Scheduler::Clock::time_point pressed;	// When the latest of those keys was pressed.
+};
+
+// Where the time goes, recorded by both threads without locks and reported by the UI thread.
+struct Instrumentation
+{
+	LatencyHistogram emulation;				// Running the VM each time the emulation thread wakes.
+	LatencyHistogram render;				// Uploading the screen and drawing it.
+	LatencyHistogram present;				// SDL_RenderPresent, which waits for vsync.
+	LatencyHistogram frame;					// From one present to the next.
+	LatencyHistogram input_to_screen;		// From a key press to the screen changing in response.
+	LatencyHistogram input_to_photon;		// From a key press to that screen being presented.
+	atomic<uint64_t> missed_vsyncs{ 0 };
+};
+
 
-void load_rom(Chip8VM& vm, string filename)
+bool load_rom(Chip8VM& vm, string filename, uint64_t seed, InputLog& log)
 {
 	// Load the ROM file into a buffer.
 	ifstream is(filename, ifstream::binary | ios::ate);
+	if (!is)
+	{
+		return false;
+	}
 	size_t len = static_cast<size_t>(is.tellg());
 	auto buffer = make_unique<Chip8VM::Byte[]>(len);
 	is.seekg(0, is.beg);
 	is.read((char*)buffer.get(), len);
 	is.close();
 
-	// Supply the buffer to the Chip-8 VM.
-	vm.load(buffer.get(), len);
+	// Supply the buffer to the Chip-8 VM, and start a log of its input.
+	if (!vm.load(buffer.get(), len, seed))
+	{
+		return false;
+	}
+	log.start(buffer.get(), len, seed);
+	return true;
+}
+
+
+// Writes the VM's state to a file.
+void save_state(const Chip8VM& vm, string filename)
+{
+	Chip8VM::State state;
+	vm.save(state);
+	ofstream os(filename, ofstream::binary);
+	os.write((const char*)&state, sizeof(state));
+}
+
+
+// Restores the VM's state from a file, if there is one.
+void load_state(Chip8VM& vm, string filename)
+{
+	auto state = make_unique<Chip8VM::State>();
+	ifstream is(filename, ifstream::binary);
+	if (is.read((char*)state.get(), sizeof(*state)) && vm.restore(*state))
+	{
+		return;
+	}
+	cerr << "Unable to load state from " << filename << endl;
+}
+
+
+// Expands the dirty rows of the screen into a streaming texture. The locked area is write-only, so every row from the first
+// dirty row to the last is rewritten.
+bool update_texture(SDL_Texture* texture, const Chip8Screen& screen)
+{
+	int first = 0;
+	int last = Chip8VM::SCREEN_HEIGHT - 1;
+	while ((screen.dirty & (1u << first)) == 0)
+	{
+		first++;
+	}
+	while ((screen.dirty & (1u << last)) == 0)
+	{
+		last--;
+	}
+
+	SDL_Rect rect{ 0, first, Chip8VM::SCREEN_WIDTH, last - first + 1 };
+	void* pixels;
+	int pitch;
+	if (SDL_LockTexture(texture, &rect, &pixels, &pitch) != 0)
+	{
+		return false;
+	}
+	expand_pixels(&screen.rows[first], last - first + 1, PixelFormat::RGBA8, PALETTE, 1, pixels, pitch);
+	SDL_UnlockTexture(texture);
+	return true;
+}
+
+
+// Replaces the whole texture with the phosphor's blended frame.
+bool update_texture(SDL_Texture* texture, const Phosphor& phosphor)
+{
+	void* pixels;
+	int pitch;
+	if (SDL_LockTexture(texture, nullptr, &pixels, &pitch) != 0)
+	{
+		return false;
+	}
+	phosphor.render(static_cast<Uint8*>(pixels), pitch);
+	SDL_UnlockTexture(texture);
+	return true;
+}
+
+
+// Reports the statistics gathered since the last report, and resets them.
+void report(ostream& out, Instrumentation& stats, double seconds)
+{
+	char line[64];
+	snprintf(line, sizeof(line), "After %.1f s:\n", seconds);
+	out << line;
+	LatencyHistogram::write_heading(out);
+	LatencyHistogram::write(out, "emulation", stats.emulation.take());
+	LatencyHistogram::write(out, "render", stats.render.take());
+	LatencyHistogram::write(out, "present", stats.present.take());
+	LatencyHistogram::write(out, "frame", stats.frame.take());
+	LatencyHistogram::write(out, "input to screen", stats.input_to_screen.take());
+	LatencyHistogram::write(out, "input to photon", stats.input_to_photon.take());
+	out << "missed vsyncs    " << stats.missed_vsyncs.exchange(0) << "\n" << endl;
+}
+
+
+// Fills the audio device's buffer from the queue, padding it with silence if the emulation thread is behind.
+void SDLCALL fill_audio(void* userdata, Uint8* stream, int len)
+{
+	auto samples = reinterpret_cast<int16_t*>(stream);
+	size_t count = static_cast<size_t>(len) / sizeof(int16_t);
+	size_t filled = static_cast<SampleQueue*>(userdata)->pop(samples, count);
+	fill(samples + filled, samples + count, int16_t(0));
 }
 
 
@@ -80,19 +259,99 @@ Chip8VM::Key convert_scancode(SDL_Scancode scancode)
 
 int main(int argc, char* argv[])
 {
-	if (argc != 2)
+	string rom_filename;
+	string record_filename;
+	uint32_t instructions_per_second = Scheduler::DEFAULT_RATE;
+	uint32_t turbo_speed = 0;
+	string stats_filename;
+
+	// Each session gets its own random numbers unless a seed is given, e.g. to reproduce one. Recordings keep the seed.
+	random_device entropy;
+	uint64_t seed = static_cast<uint64_t>(entropy()) << 32 | entropy();
+	try
 	{
-		cerr << "Usage: " << argv[0] << " <filename>\n";
+		for (auto i = 1; i < argc; i++)
+		{
+			string arg = argv[i];
+			if (arg == "--record" && i + 1 < argc)
+			{
+				record_filename = argv[++i];
+			}
+			else if (arg == "--ips" && i + 1 < argc)
+			{
+				instructions_per_second = stoul(argv[++i]);
+			}
+			else if (arg == "--turbo" && i + 1 < argc)
+			{
+				turbo_speed = stoul(argv[++i]);
+			}
+			else if (arg == "--stats" && i + 1 < argc)
+			{
+				stats_filename = argv[++i];
+			}
+			else if (arg == "--seed" && i + 1 < argc)
+			{
+				seed = stoull(argv[++i], nullptr, 0);
+			}
+			else if (rom_filename.empty())
+			{
+				rom_filename = arg;
+			}
+			else
+			{
+				rom_filename.clear();
+				break;
+			}
+		}
+	}
+	catch (const logic_error&)
+	{
+		// A malformed number.
+		rom_filename.clear();
+	}
+	if (rom_filename.empty())
+	{
+		cerr << "Usage: " << argv[0] << " [--record <log>] [--ips <instructions per second>] [--turbo <speed>] [--stats <file|->] [--seed <n>] <filename>\n";
 		return USAGE;
 	}
 
 	auto vm_handle = make_unique<Chip8VM>();
 	Chip8VM& vm = *vm_handle;
 
-	load_rom(vm, argv[1]);
+	InputLog log;
+	if (!load_rom(vm, rom_filename, seed, log))
+	{
+		cerr << "Unable to load ROM " << rom_filename << ", which must exist and fit in the VM's memory" << endl;
+		return FAILED;
+	}
+	string state_filename = rom_filename + ".state";
+	bool recording = !record_filename.empty();
+
+	// Everything that reaches the VM from outside goes through these, so that it can be recorded.
+	auto key_pressed = [&](Chip8VM::Key key) {
+		if (recording)
+		{
+			log.record(vm, InputLog::Type::KEY_DOWN, key);
+		}
+		vm.key_pressed(key);
+	};
+	auto key_released = [&](Chip8VM::Key key) {
+		if (recording)
+		{
+			log.record(vm, InputLog::Type::KEY_UP, key);
+		}
+		vm.key_released(key);
+	};
+	auto tick = [&]() {
+		if (recording)
+		{
+			log.record(vm, InputLog::Type::TICK);
+		}
+		vm.tick();
+	};
 
 	// Initialise SDL.
-	if (SDL_Init(SDL_INIT_VIDEO) != 0)
+	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) != 0)
 	{
 		cerr << "SDL_Init: Error: " << SDL_GetError() << endl;
 		return FAILED;
@@ -124,6 +383,306 @@ int main(int argc, char* argv[])
 		return FAILED;
 	}
 
+	// Create a texture with one texel per VM pixel. It's updated from the CPU as rows change and scaled up when it's drawn.
+	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
+	handle<SDL_Texture> th(
+		SDL_CreateTexture(renderer, TEXTURE_FORMAT, SDL_TEXTUREACCESS_STREAMING, Chip8VM::SCREEN_WIDTH, Chip8VM::SCREEN_HEIGHT),
+		SDL_DestroyTexture);
+	SDL_Texture* texture = th.get();
+
+	if (texture == nullptr)
+	{
+		cerr << "SDL_CreateTexture: Error: " << SDL_GetError() << endl;
+		SDL_Quit();
+		return FAILED;
+	}
+
+	// Open an audio device for the buzzer. The game carries on silently if there isn't one.
+	SampleQueue audio_samples;
+	SDL_AudioSpec want{};
+	want.freq = Beeper::DEFAULT_SAMPLE_RATE;
+	want.format = AUDIO_S16SYS;
+	want.channels = 1;
+	want.samples = AUDIO_BUFFER_SAMPLES;
+	want.callback = fill_audio;
+	want.userdata = &audio_samples;
+	SDL_AudioSpec have = want;
+	SDL_AudioDeviceID audio = SDL_OpenAudioDevice(nullptr, 0, &want, &have, 0);
+	if (audio == 0)
+	{
+		cerr << "SDL_OpenAudioDevice: Error: " << SDL_GetError() << endl;
+	}
+	else
+	{
+		SDL_PauseAudioDevice(audio, 0);
+	}
+
+	// The VM runs on its own thread so that a slow present never slows the game down, and vice versa. Input goes to it
+	// through a queue and screens come back through a triple buffer, so neither thread ever waits for the other.
+	SpscQueue<Command, 256> commands;
+	TripleBuffer<Frame> screens;
+
+	// The emulation thread waits on a condition variable between ticks, and indefinitely while the VM is waiting for a
+	// key with its timers stopped and nothing new to show. Commands wake it.
+	mutex wake_mutex;
+	condition_variable wake;
+	atomic<bool> idle{ false };
+
+	// Measured by both threads and reported every STATS_INTERVAL with --stats, or summarised at exit without.
+	Instrumentation stats;
+
+	thread emulation([&]() {
+		// Keep the last minute of frames so that the player can rewind with backspace.
+		RewindBuffer history(60 * 60, 60);
+		history.push(vm);
+		bool rewinding = false;
+
+		// Tab toggles fast-forwarding, at turbo_speed times normal speed or, if that's 0, as fast as possible. The VM
+		// still runs on emulated time, so its timers keep step with its instructions, and it's silent meanwhile.
+		bool fast_forwarding = false;
+		auto last_display = Scheduler::Clock::now();
+
+		// When recording, the size of the log at each frame, so that rewinding can discard the input that it undoes.
+		vector<size_t> log_sizes{ 0 };
+
+		// The buzzer's samples for each tick are made into a buffer on this thread's stack and queued for the audio
+		// callback, so sound costs no locks or allocations.
+		Beeper beeper(have.freq);
+		int16_t samples[Beeper::MAXIMUM_TICK_SAMPLES];
+
+		// Each frame ends at a timer tick, when it's added to the history. Rewinding steps back a frame per tick instead.
+		auto end_frame = [&]() {
+			history.push(vm);
+			if (recording)
+			{
+				log_sizes.push_back(log.events.size());
+
+				// Checkpoint once a minute so that the recording can be verified in parallel.
+				if (history.newest() % CHECKPOINT_INTERVAL == 0)
+				{
+					log.checkpoint(vm);
+				}
+			}
+			if (audio != 0 && !fast_forwarding)
+			{
+				size_t count = beeper.tick(vm.is_sounding(), samples);
+				if (audio_samples.size() < MAXIMUM_QUEUED_SAMPLES)
+				{
+					audio_samples.push(samples, count);
+				}
+			}
+			tick();
+		};
+		auto rewind_frame = [&]() {
+			if (history.newest() > history.oldest())
+			{
+				history.rewind(history.newest() - 1, vm);
+				if (recording)
+				{
+					log_sizes.resize(static_cast<size_t>(history.newest() + 1));
+					log.truncate(vm, log_sizes.back());
+				}
+			}
+		};
+		auto step = [&](uint32_t instructions) { vm.step(instructions); };
+		auto skip = [](uint32_t) {};
+
+		// The CPU and timers run at fixed rates against the clock, however often this loop happens to wake.
+		Scheduler scheduler(instructions_per_second);
+		auto last = Scheduler::Clock::now();
+
+		// The time of the first key press that the screen hasn't changed since, and the screen when it happened.
+		bool awaiting_response = false;
+		Scheduler::Clock::time_point pressed;
+		array<uint64_t, Chip8VM::SCREEN_HEIGHT> screen_when_pressed;
+		uint64_t responses = 0;
+		Scheduler::Clock::time_point responded_to;
+
+		for (;;)
+		{
+			// Run the VM up to the moment each command's event happened before applying it, so that input lands at the
+			// instruction boundary that matches its time rather than at the start of the next batch. Events from
+			// before the VM's last run can only be applied now.
+			auto now = Scheduler::Clock::now();
+			Command command;
+			while (commands.pop(command))
+			{
+				if (!rewinding && !fast_forwarding && command.time > last)
+				{
+					auto time = min(command.time, now);
+					scheduler.advance(time - last, end_frame, step);
+					last = time;
+				}
+
+				switch (command.type)
+				{
+				case Command::Type::KEY_DOWN:
+					key_pressed(command.key);
+					if (!awaiting_response && command.key != Chip8VM::Key::NO_KEY)
+					{
+						awaiting_response = true;
+						pressed = command.time;
+						screen_when_pressed = vm.io.screen.rows;
+					}
+					break;
+				case Command::Type::KEY_UP:
+					key_released(command.key);
+					break;
+				case Command::Type::SAVE_STATE:
+					save_state(vm, state_filename);
+					break;
+				case Command::Type::LOAD_STATE:
+					load_state(vm, state_filename);
+					history.clear();
+					history.push(vm);
+					break;
+				case Command::Type::REWIND_START:
+					rewinding = true;
+					break;
+				case Command::Type::REWIND_STOP:
+					rewinding = false;
+					break;
+				case Command::Type::TURBO:
+					fast_forwarding = !fast_forwarding;
+					break;
+				case Command::Type::QUIT:
+					return;
+				}
+			}
+
+			auto start = now;
+			if (rewinding)
+			{
+				scheduler.advance(now - last, rewind_frame, skip);
+			}
+			else if (fast_forwarding && turbo_speed == 0)
+			{
+				// Run whole frames back to back for a slice of host time.
+				do
+				{
+					scheduler.advance(scheduler.until_tick(), end_frame, step);
+				} while (Scheduler::Clock::now() - now < TURBO_SLICE);
+				now = Scheduler::Clock::now();
+			}
+			else if (fast_forwarding)
+			{
+				scheduler.advance((now - last) * turbo_speed, end_frame, step);
+			}
+			else
+			{
+				scheduler.advance(now - last, end_frame, step);
+			}
+			last = now;
+			stats.emulation.record(Scheduler::Clock::now() - start);
+
+			// Hand the screen over to the UI thread if it has changed, skipping frames that it couldn't show while
+			// fast-forwarding.
+			if (vm.io.screen.changed() && (!fast_forwarding || now - last_display >= DISPLAY_INTERVAL))
+			{
+				if (awaiting_response && vm.io.screen.rows != screen_when_pressed)
+				{
+					stats.input_to_screen.record(Scheduler::Clock::now() - pressed);
+					awaiting_response = false;
+					responses++;
+					responded_to = pressed;
+				}
+
+				Frame& frame = screens.back();
+				frame.screen = vm.io.screen;
+				frame.responses = responses;
+				frame.pressed = responded_to;
+				screens.publish();
+				vm.io.screen.clean();
+				last_display = now;
+
+				// Wake the UI thread in case it's waiting for an event.
+				SDL_Event screen_ready{};
+				screen_ready.type = SDL_USEREVENT;
+				SDL_PushEvent(&screen_ready);
+			}
+
+			// Nothing can happen until a key is pressed, so sleep until a command arrives, then carry on as if no time had
+			// passed.
+			auto has_command = [&]() { return commands.size() > 0; };
+			if (vm.is_idle() && !rewinding && !vm.io.screen.changed())
+			{
+				idle.store(true, memory_order_release);
+				unique_lock<mutex> lock(wake_mutex);
+				wake.wait(lock, has_command);
+				idle.store(false, memory_order_release);
+				last = Scheduler::Clock::now();
+			}
+			else if (!fast_forwarding || turbo_speed > 0)
+			{
+				unique_lock<mutex> lock(wake_mutex);
+				wake.wait_for(lock, scheduler.until_tick() / (fast_forwarding ? turbo_speed : 1), has_command);
+			}
+		}
+	});
+
+	bool sent = false;		// Whether a command has been sent since the UI thread last decided whether to sleep.
+	auto send = [&](Command::Type type, Chip8VM::Key key, Scheduler::Clock::time_point time) {
+		while (!commands.push(Command{ type, key, time }))
+		{
+			this_thread::yield();
+		}
+		lock_guard<mutex> lock(wake_mutex);
+		wake.notify_one();
+		sent = true;
+	};
+
+	// The screen as last uploaded to the texture. Its dirty rows are the ones that differ from the newest screen.
+	Chip8Screen shown{};
+	shown.dirty = Chip8Screen::ALL_ROWS;
+
+	// F7 toggles a simulated phosphor persistence that hides the flicker of XOR-drawn sprites. It fades once per timer
+	// tick, paced against the clock like the VM, so it looks the same whatever the refresh rate and with dropped frames.
+	Phosphor phosphor(0x80, PALETTE);
+	bool persistence = false;
+	Scheduler fade;
+	auto last_fade = Scheduler::Clock::now();
+	bool turbo = false;
+
+	// Statistics go to a file, or to stderr for "-", every STATS_INTERVAL.
+	ofstream stats_file;
+	ostream* stats_out = nullptr;
+	if (stats_filename == "-")
+	{
+		stats_out = &cerr;
+	}
+	else if (!stats_filename.empty())
+	{
+		stats_file.open(stats_filename);
+		if (stats_file)
+		{
+			stats_out = &stats_file;
+		}
+		else
+		{
+			cerr << "Unable to write statistics to " << stats_filename << endl;
+		}
+	}
+	auto started = Scheduler::Clock::now();
+	auto last_report = started;
+
+	// Presents more than one and a half refreshes apart have missed vsyncs.
+	SDL_DisplayMode mode;
+	int refresh_rate = SDL_GetWindowDisplayMode(window, &mode) == 0 && mode.refresh_rate > 0 ? mode.refresh_rate : 60;
+	auto refresh = chrono::duration_cast<Scheduler::Clock::duration>(chrono::duration<double>(1.0 / refresh_rate));
+	auto last_present = Scheduler::Clock::now();
+	bool was_waiting = true;
+
+	// The number of responses to key presses seen in screens so far, and whether the latest is yet to be presented.
+	uint64_t responses = 0;
+	bool response_pending = false;
+	Scheduler::Clock::time_point response_pressed;
+
+	// SDL stamps events with the milliseconds since it started. This converts them to the scheduler's clock.
+	auto sdl_epoch = Scheduler::Clock::now() - chrono::milliseconds(SDL_GetTicks());
+	auto event_time = [&](Uint32 timestamp) {
+		return min(sdl_epoch + chrono::milliseconds(timestamp), Scheduler::Clock::now());
+	};
+
 	SDL_Event event;
 	bool quit = false;
 	while (!quit)
@@ -131,49 +690,159 @@ int main(int argc, char* argv[])
 		// Process events.
 		while (SDL_PollEvent(&event))
 		{
+			auto time = event_time(event.common.timestamp);
 			switch (event.type)
 			{
 			case SDL_QUIT:
 				quit = true;
 				break;
 			case SDL_KEYDOWN:
-				vm.key_pressed(convert_scancode(event.key.keysym.scancode));
+				if (event.key.keysym.scancode == SDL_SCANCODE_F5 && !event.key.repeat)
+				{
+					send(Command::Type::SAVE_STATE, Chip8VM::Key::NO_KEY, time);
+				}
+				else if (event.key.keysym.scancode == SDL_SCANCODE_F9 && !event.key.repeat && recording)
+				{
+					cerr << "Loading a state is disabled while recording" << endl;
+				}
+				else if (event.key.keysym.scancode == SDL_SCANCODE_F9 && !event.key.repeat)
+				{
+					send(Command::Type::LOAD_STATE, Chip8VM::Key::NO_KEY, time);
+				}
+				else if (event.key.keysym.scancode == SDL_SCANCODE_F7 && !event.key.repeat)
+				{
+					persistence = !persistence;
+					phosphor.reset();
+					last_fade = Scheduler::Clock::now();
+					shown.dirty = Chip8Screen::ALL_ROWS;
+				}
+				else if (event.key.keysym.scancode == SDL_SCANCODE_BACKSPACE)
+				{
+					send(Command::Type::REWIND_START, Chip8VM::Key::NO_KEY, time);
+				}
+				else if (event.key.keysym.scancode == SDL_SCANCODE_TAB && !event.key.repeat)
+				{
+					send(Command::Type::TURBO, Chip8VM::Key::NO_KEY, time);
+					turbo = !turbo;
+					SDL_SetWindowTitle(window, turbo ? "CHIP-8 in C++ (fast-forward)" : "CHIP-8 in C++");
+				}
+				send(Command::Type::KEY_DOWN, convert_scancode(event.key.keysym.scancode), time);
 				break;
 			case SDL_KEYUP:
-				vm.key_released(convert_scancode(event.key.keysym.scancode));
+				if (event.key.keysym.scancode == SDL_SCANCODE_BACKSPACE)
+				{
+					send(Command::Type::REWIND_STOP, Chip8VM::Key::NO_KEY, time);
+				}
+				send(Command::Type::KEY_UP, convert_scancode(event.key.keysym.scancode), time);
 				break;
 			}
 		}
 
-		// Tick the delay timer (based on the not necessarily true assumption that we're refreshing at 60Hz).
-		vm.tick();
+		// Take the newest screen that the emulation thread has finished, if there is one.
+		if (screens.update())
+		{
+			const Frame& frame = screens.front();
+			for (auto y = 0; y < Chip8VM::SCREEN_HEIGHT; y++)
+			{
+				shown.dirty |= frame.screen.rows[y] != shown.rows[y] ? (1u << y) : 0;
+			}
+			shown.rows = frame.screen.rows;
 
-		// Bump the VM on by a few instructions.
-		vm.step(10);
+			// Screens skipped on the way still pass their responses on, through the count.
+			if (frame.responses != responses)
+			{
+				responses = frame.responses;
+				response_pending = true;
+				response_pressed = frame.pressed;
+			}
+		}
 
-		// Clear the screen in dark grey.
-		SDL_SetRenderDrawColor(renderer, 0x0f, 0x0f, 0x0f, 0xff);
-		SDL_RenderClear(renderer);
+		// Upload the rows of the screen that have changed, or the whole blended frame while it's fading.
+		auto render_start = Scheduler::Clock::now();
+		if (persistence)
+		{
+			fade.advance(render_start - last_fade, [&]() { phosphor.tick(shown); }, [](uint32_t) {});
+			last_fade = render_start;
+			update_texture(texture, phosphor);
+			shown.clean();
+		}
+		else if (shown.changed() && update_texture(texture, shown))
+		{
+			shown.clean();
+		}
+
+		SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+		auto rendered = Scheduler::Clock::now();
+		SDL_RenderPresent(renderer);
+		auto presented = Scheduler::Clock::now();
 
-		// Draw the VM's screen in green.
-		SDL_SetRenderDrawColor(renderer, 0x00, 0xff, 0x00, 0xff);
-		for (auto y = 0; y < Chip8VM::SCREEN_HEIGHT; y++)
+		stats.render.record(rendered - render_start);
+		stats.present.record(presented - rendered);
+		if (!was_waiting)
 		{
-			for (auto x = 0; x < Chip8VM::SCREEN_WIDTH; x++)
+			auto interval = presented - last_present;
+			stats.frame.record(interval);
+			if (interval > refresh * 3 / 2)
 			{
-				if (vm.io.screen.test(x + Chip8VM::SCREEN_WIDTH * y))
-				{
-					SDL_Rect rect{ x * SCALING, y * SCALING, SCALING, SCALING };
-					SDL_RenderFillRect(renderer, &rect);
-				}
+				stats.missed_vsyncs += static_cast<uint64_t>((interval + refresh / 2) / refresh) - 1;
 			}
 		}
+		last_present = presented;
+		if (response_pending)
+		{
+			stats.input_to_photon.record(presented - response_pressed);
+			response_pending = false;
+		}
 
-		SDL_RenderPresent(renderer);
+		if (stats_out && presented - last_report >= STATS_INTERVAL)
+		{
+			report(*stats_out, stats, chrono::duration<double>(presented - started).count());
+			last_report = presented;
+		}
+
+		// Rather than presenting the same frame at every refresh, sleep until something happens. The emulation thread
+		// only goes idle after handing over its last screen, and any command sent since this was last decided may yet
+		// wake it. A screen that it hands over after this check comes with an event, which ends the wait at once.
+		was_waiting = !sent && !persistence && idle.load(memory_order_acquire);
+		sent = false;
+		if (was_waiting)
+		{
+			SDL_WaitEventTimeout(nullptr, IDLE_TIMEOUT_MS);
+		}
+	}
+
+	send(Command::Type::QUIT, Chip8VM::Key::NO_KEY, Scheduler::Clock::now());
+	emulation.join();
+	if (audio != 0)
+	{
+		SDL_CloseAudioDevice(audio);
+	}
+
+	if (stats_out)
+	{
+		report(*stats_out, stats, chrono::duration<double>(Scheduler::Clock::now() - started).count());
+	}
+	else if (stats.input_to_screen.summary().count > 0)
+	{
+		auto latency = stats.input_to_screen.summary();
+		char line[96];
+		snprintf(line, sizeof(line), "Key press to screen change: %llu presses, mean %.1f ms, worst %.1f ms",
+			(unsigned long long)latency.count, latency.mean / 1e6, latency.maximum / 1e6);
+		cerr << line << endl;
 	}
 
 	// Clean up and quit.
 	SDL_Quit();
 
+	if (recording)
+	{
+		log.finish(vm);
+		if (!log.save(record_filename))
+		{
+			cerr << "Unable to save input log to " << record_filename << endl;
+			return FAILED;
+		}
+	}
+
 	return SUCCEEDED;
 }
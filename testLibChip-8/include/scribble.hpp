@@ -0,0 +1,16 @@
+#pragma once
+
+#include <libChip-8/include/chip8vm.hpp>
+
+
+// Compiles a program that scribbles random digits over the screen forever, so that tests have an irregular, changing
+// screen that exercises every bit position. Each digit takes six instructions to draw.
+inline void compile_scribble(Chip8VM& vm)
+{
+	vm.compile(0xc0ff);			// RND V0, FFH
+	vm.compile(0xc1ff);			// RND V1, FFH
+	vm.compile(0xc20f);			// RND V2, 0FH
+	vm.compile(0xf229);			// LD F, V2
+	vm.compile(0xd015);			// DRW V0, V1, 5
+	vm.compile(0x1200);			// JP 200H
+}
@@ -0,0 +1,79 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <string>
+
+#include <libChip-8/include/audio.hpp>
+
+
+TEST_CASE("Beeper")
+{
+	int16_t samples[Beeper::MAXIMUM_TICK_SAMPLES];
+
+	SECTION("a second of ticks makes a second of samples")
+	{
+		for (uint32_t rate : { 44100, 48000, 22050 })
+		{
+			Beeper beeper(rate);
+			size_t total = 0;
+			for (auto tick = 0; tick < 60; tick++)
+			{
+				total += beeper.tick(tick % 2 == 0, samples);
+			}
+			REQUIRE(total == rate);
+		}
+	}
+
+	SECTION("the beep is a square wave at the set frequency")
+	{
+		Beeper beeper(48000, 400, 1000);
+		REQUIRE(beeper.tick(true, samples) == 800);
+
+		// 400 Hz at 48 kHz is 120 samples a cycle: 60 high then 60 low.
+		unsigned edges = 0;
+		for (size_t n = 0; n < 800; n++)
+		{
+			REQUIRE((samples[n] == 1000 || samples[n] == -1000));
+			edges += n > 0 && samples[n] != samples[n - 1];
+		}
+		REQUIRE(samples[0] == 1000);
+		REQUIRE(samples[59] == 1000);
+		REQUIRE(samples[61] == -1000);
+		REQUIRE(edges == 13);
+	}
+
+	SECTION("silence is zero")
+	{
+		Beeper beeper;
+		size_t count = beeper.tick(false, samples);
+		REQUIRE(count == 735);
+		for (size_t n = 0; n < count; n++)
+		{
+			REQUIRE(samples[n] == 0);
+		}
+	}
+}
+
+
+TEST_CASE("WAV writer")
+{
+	std::ostringstream out;
+	WavWriter wav(out, 8000);
+	int16_t samples[] = { 0, 1, -1, 0x1234 };
+	wav.write(samples, 4);
+	wav.finish();
+	REQUIRE(wav.samples() == 4);
+
+	std::string data = out.str();
+	REQUIRE(data.size() == 44 + 8);
+	REQUIRE(data.compare(0, 4, "RIFF") == 0);
+	REQUIRE(data.compare(8, 8, "WAVEfmt ") == 0);
+	REQUIRE(data.compare(36, 4, "data") == 0);
+	auto word = [&](size_t at) {
+		return uint8_t(data[at]) | uint8_t(data[at + 1]) << 8 | uint8_t(data[at + 2]) << 16 | uint32_t(uint8_t(data[at + 3])) << 24;
+	};
+	REQUIRE(word(4) == 36 + 8);
+	REQUIRE(word(24) == 8000);
+	REQUIRE(word(40) == 8);
+	REQUIRE(data.substr(44) == std::string("\x00\x00\x01\x00\xff\xff\x34\x12", 8));
+}
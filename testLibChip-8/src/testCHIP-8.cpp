@@ -1,5 +1,7 @@
 #include "catch.hpp"
 
+#include <vector>
+
 #include <libChip-8\include\chip8vm.hpp>
 
 
@@ -385,6 +387,25 @@ TEST_CASE("Instructions")
 		}
 	}
 
+	SECTION("DRW Vx, Vy, nibble wraps around the screen")
+	{
+		vm.reg.v[0x0] = 60;
+		vm.reg.v[0x1] = 31;
+		vm.reg.i = 0x100;
+		vm.memory[0x100] = 0xff;
+		vm.memory[0x101] = 0x81;
+		vm.compile(0xD012);			// DRW V0, V1, 2
+		vm.step(1);
+		for (auto x = 0; x < 64; x++)
+		{
+			bool first_row = x >= 60 || x < 4;
+			bool second_row = x == 60 || x == 3;
+			REQUIRE(vm.io.screen.test(x + 64 * 31) == first_row);
+			REQUIRE(vm.io.screen.test(x) == second_row);
+		}
+		REQUIRE(vm.reg.v[0x0f] == 0);
+	}
+
 	SECTION("SKP Vx")
 	{
 		SECTION("key pressed")
@@ -492,6 +513,42 @@ TEST_CASE("Instructions")
 		REQUIRE(vm.reg.pc == 0x204);
 	}
 
+	SECTION("timers count down to zero")
+	{
+		vm.compile(0x6902);			// LD V9, 02H
+		vm.compile(0xf915);			// LD DT, V9
+		vm.compile(0x6603);			// LD V6, 03H
+		vm.compile(0xf618);			// LD ST, V6
+		vm.step(4);
+		REQUIRE(vm.is_sounding());
+		vm.tick();
+		vm.tick();
+		REQUIRE(vm.reg.dt == 0);
+		REQUIRE(vm.reg.st == 1);
+		REQUIRE(vm.is_sounding());
+		vm.tick();
+		vm.tick();
+		REQUIRE(vm.reg.dt == 0);
+		REQUIRE(vm.reg.st == 0);
+		REQUIRE_FALSE(vm.is_sounding());
+	}
+
+	SECTION("a VM waiting for a key with its timers stopped is idle")
+	{
+		vm.compile(0x6602);			// LD V6, 02H
+		vm.compile(0xf615);			// LD DT, V6
+		vm.compile(0xf00a);			// LD V0, K
+		vm.step(3);
+		REQUIRE(vm.is_waiting_for_key());
+		REQUIRE_FALSE(vm.is_idle());
+		vm.tick();
+		vm.tick();
+		REQUIRE(vm.is_idle());
+		vm.key_pressed(Chip8VM::Key::KEY_5);
+		REQUIRE_FALSE(vm.is_waiting_for_key());
+		REQUIRE_FALSE(vm.is_idle());
+	}
+
 	SECTION("ADD I, Vx")
 	{
 		vm.reg.i = 0x500;
@@ -556,3 +613,261 @@ TEST_CASE("Instructions")
 		REQUIRE(vm.reg.pc == 0x202);
 	}
 }
+
+
+TEST_CASE("Random numbers")
+{
+	Chip8VM vm;
+
+	auto run = [&vm](uint64_t seed) {
+		vm.reset(seed);
+		vm.compile(0xc1ff);			// RND V1, FFH
+		vm.compile(0xc2ff);			// RND V2, FFH
+		vm.compile(0xc3ff);			// RND V3, FFH
+		vm.step(3);
+		return (vm.reg.v[1] << 16) | (vm.reg.v[2] << 8) | vm.reg.v[3];
+	};
+
+	SECTION("the same seed gives the same sequence")
+	{
+		REQUIRE(run(1234) == run(1234));
+	}
+
+	SECTION("different seeds give different sequences")
+	{
+		REQUIRE(run(1234) != run(5678));
+	}
+
+	SECTION("the generator can be snapshotted")
+	{
+		vm.reset(99);
+		Chip8Random saved = vm.random;
+		auto first = vm.random.next();
+		vm.random = saved;
+		REQUIRE(vm.random.next() == first);
+		REQUIRE(Chip8Random::at(99, 0) == first);
+	}
+}
+
+
+TEST_CASE("Self-modifying code")
+{
+	Chip8VM vm;
+
+	vm.compile(0x6012);			// LD V0, 12H
+	vm.compile(0x6134);			// LD V1, 34H
+	vm.compile(0xa208);			// LD I, 208H
+	vm.compile(0xf155);			// LD [I], V1
+	vm.compile(0x1350);			// JP 350H (overwritten with JP 234H)
+	vm.step(5);
+	REQUIRE(vm.reg.pc == 0x234);
+}
+
+
+TEST_CASE("Save states")
+{
+	Chip8VM vm;
+	Chip8VM::State state;
+
+	vm.compile(0x6a42);			// LD VA, 42H
+	vm.compile(0xa300);			// LD I, 300H
+	vm.compile(0xfa33);			// LD B, VA
+	vm.compile(0xc0ff);			// RND V0, FFH
+	vm.compile(0xd005);			// DRW V0, V0, 5
+	vm.compile(0x120a);			// JP 20AH
+	vm.step(3);
+	vm.save(state);
+	auto hash = vm.hash();
+
+	SECTION("a snapshot is valid")
+	{
+		REQUIRE(state.is_valid());
+		REQUIRE(state.instructions == 3);
+		REQUIRE(state.v[0xa] == 0x42);
+	}
+
+	SECTION("restoring rewinds the VM")
+	{
+		vm.step(2);
+		auto ahead = vm.hash();
+		REQUIRE(ahead != hash);
+		REQUIRE(vm.restore(state));
+		REQUIRE(vm.hash() == hash);
+		vm.step(2);
+		REQUIRE(vm.hash() == ahead);
+	}
+
+	SECTION("restoring into a fresh VM recompiles its memory")
+	{
+		Chip8VM other;
+		REQUIRE(other.restore(state));
+		REQUIRE(other.hash() == hash);
+		vm.step(20);
+		other.step(20);
+		REQUIRE(other.hash() == vm.hash());
+		REQUIRE(other.instructions == vm.instructions);
+	}
+
+	SECTION("invalid snapshots are rejected")
+	{
+		state.version++;
+		REQUIRE(!vm.restore(state));
+	}
+
+	SECTION("snapshots with addresses outside memory are rejected")
+	{
+		Chip8VM::State corrupt = state;
+		corrupt.pc = Chip8VM::MEMORY_SIZE;
+		REQUIRE(!vm.restore(corrupt));
+
+		corrupt = state;
+		corrupt.stack[15] = 0x8000;
+		REQUIRE(!vm.restore(corrupt));
+		REQUIRE(vm.hash() == hash);
+	}
+
+	SECTION("a full-size ROM can be saved and restored")
+	{
+		Chip8VM other;
+		vector<Chip8VM::Byte> rom(Chip8VM::MEMORY_SIZE - 0x200, 0x12);		// JP 212H, over and over.
+		other.load(rom.data(), rom.size());
+		other.step(10);
+		other.save(state);
+		REQUIRE(state.here == 0x1000);
+		REQUIRE(vm.restore(state));
+		REQUIRE(vm.hash() == other.hash());
+
+		// One byte more doesn't fit, and isn't loaded at all.
+		rom.push_back(0x12);
+		REQUIRE(!other.load(rom.data(), rom.size()));
+		REQUIRE(other.reg.pc == 0x200);
+		REQUIRE(other.memory[0x200] == 0);
+	}
+
+	SECTION("I can be saved and restored beyond the end of memory")
+	{
+		vm.reg.i = 0xff0;
+		vm.reg.v[0] = 0xff;
+		vm.compile(0xf01e);		// ADD I, V0
+		vm.reg.pc = 0x20c;
+		vm.step();
+		REQUIRE(vm.reg.i == 0x10ef);
+		vm.save(state);
+		REQUIRE(state.is_valid());
+		Chip8VM other;
+		REQUIRE(other.restore(state));
+		REQUIRE(other.reg.i == 0x10ef);
+	}
+}
+
+
+TEST_CASE("State hash")
+{
+	Chip8VM vm;
+
+	vm.compile(0xc0ff);			// RND V0, FFH
+	vm.compile(0xc1ff);			// RND V1, FFH
+	vm.compile(0xa300);			// LD I, 300H
+	vm.compile(0xf01e);			// ADD I, V0
+	vm.compile(0xf155);			// LD [I], V1
+	vm.compile(0xf033);			// LD B, V0
+	vm.compile(0xd015);			// DRW V0, V1, 5
+	vm.compile(0x00e0);			// CLS (skipped every other time)
+	vm.compile(0x4100);			// SNE V1, 0
+	vm.compile(0x1200);			// JP 200H
+	vm.compile(0xd105);			// DRW V1, V0, 5
+	vm.compile(0x1200);			// JP 200H
+
+	SECTION("the incremental hash matches a full recalculation")
+	{
+		for (auto i = 0; i < 50; i++)
+		{
+			vm.step(37);
+			auto incremental = vm.hash();
+			vm.rehash();
+			REQUIRE(vm.hash() == incremental);
+		}
+	}
+
+	SECTION("the hash covers registers")
+	{
+		auto before = vm.hash();
+		vm.reg.v[0xe] ^= 1;
+		REQUIRE(vm.hash() != before);
+		vm.reg.v[0xe] ^= 1;
+		REQUIRE(vm.hash() == before);
+	}
+
+	SECTION("the hash covers the random number generator")
+	{
+		// A loop that only ends when RND returns 1 comes back to the same registers and memory each time round, but
+		// it isn't stuck: what happens next depends on the generator.
+		Chip8VM loop;
+		loop.compile(0xc001);		// RND V0, 01H
+		loop.compile(0x3001);		// SE V0, 01H
+		loop.compile(0x1200);		// JP 200H
+		uint64_t seed = 0;
+		while ((Chip8Random::at(seed, 0) >> 56) & 1)
+		{
+			seed++;
+		}
+		loop.random.reseed(seed);
+		auto before = loop.hash();
+		loop.step(3);
+		REQUIRE(loop.reg.pc == 0x200);
+		REQUIRE(loop.reg.v[0] == 0);
+		REQUIRE(loop.hash() != before);
+	}
+}
+
+
+TEST_CASE("Dirty rows")
+{
+	Chip8VM vm;
+
+	SECTION("a fresh VM needs a full redraw")
+	{
+		REQUIRE(vm.io.screen.dirty == Chip8Screen::ALL_ROWS);
+	}
+
+	vm.io.screen.clean();
+	vm.reg.v[0x0] = 4;
+	vm.reg.v[0x1] = 30;
+	vm.reg.i = 0x100;
+	vm.memory[0x100] = 0xff;
+	vm.memory[0x101] = 0x00;
+	vm.memory[0x102] = 0x81;
+
+	SECTION("DRW marks the rows that it changes")
+	{
+		vm.compile(0xd013);			// DRW V0, V1, 3
+		vm.step();
+		REQUIRE(vm.io.screen.changed());
+		REQUIRE(vm.io.screen.dirty == ((1u << 30) | (1u << 0)));
+	}
+
+	SECTION("CLS marks only the rows that were lit")
+	{
+		vm.compile(0xd013);			// DRW V0, V1, 3
+		vm.compile(0x00e0);			// CLS
+		vm.step();
+		vm.io.screen.clean();
+		vm.step();
+		REQUIRE(vm.io.screen.dirty == ((1u << 30) | (1u << 0)));
+		vm.io.screen.clean();
+		vm.compile(0x00e0);			// CLS
+		vm.step();
+		REQUIRE_FALSE(vm.io.screen.changed());
+	}
+
+	SECTION("restoring a state marks the rows that differ")
+	{
+		Chip8VM::State state;
+		vm.save(state);
+		vm.compile(0xd013);			// DRW V0, V1, 3
+		vm.step();
+		vm.io.screen.clean();
+		vm.restore(state);
+		REQUIRE(vm.io.screen.dirty == ((1u << 30) | (1u << 0)));
+	}
+}
@@ -0,0 +1,46 @@
+#include "catch.hpp"
+
+#include <libChip-8/include/chip8env.hpp>
+
+
+TEST_CASE("Batched environment")
+{
+	// Draws the font character for the key in V0 whenever that key is held, then clears the screen.
+	Chip8VM::Byte program[] = {
+		0x60, 0x05,		// LD V0, 5H
+		0x00, 0xe0,		// CLS
+		0xe0, 0xa1,		// SKNP V0
+		0xd1, 0x15,		// DRW V1, V1, 5 (I defaults to the font for 0)
+		0x12, 0x02		// JP 202H
+	};
+	Chip8Env env(3, program, sizeof(program), 4);
+
+	SECTION("every instance starts with a blank screen")
+	{
+		for (size_t n = 0; n < env.size() * Chip8Env::OBSERVATION_WORDS; n++)
+		{
+			REQUIRE(env.observations()[n] == 0);
+		}
+	}
+
+	SECTION("actions are applied per instance")
+	{
+		Chip8Env::KeyMask actions[] = { 0, 1 << 5, 1 << 4 };
+		env.step(actions);
+		const uint64_t* obs = env.observations();
+		REQUIRE(obs[0 * Chip8Env::OBSERVATION_WORDS] == 0);
+		REQUIRE(obs[1 * Chip8Env::OBSERVATION_WORDS] == 0xf000000000000000ull);
+		REQUIRE(obs[2 * Chip8Env::OBSERVATION_WORDS] == 0);
+		REQUIRE(env.vm(1).io.keys[5]);
+		REQUIRE(!env.vm(2).io.keys[5]);
+	}
+
+	SECTION("rewards come from the reward hook")
+	{
+		env.set_reward([](const Chip8VM& vm, size_t index) { return vm.io.screen.any() ? 1.0f : float(index) / 10; });
+		Chip8Env::KeyMask actions[] = { 1 << 5, 0, 0 };
+		env.step(actions);
+		REQUIRE(env.rewards()[0] == 1.0f);
+		REQUIRE(env.rewards()[2] == 0.2f);
+	}
+}
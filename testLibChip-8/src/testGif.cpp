@@ -0,0 +1,244 @@
+#include "catch.hpp"
+#include "scribble.hpp"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <libChip-8/include/gif.hpp>
+
+
+// A minimal GIF decoder that understands just enough to check what GifWriter produces: a global colour table, graphic
+// control extensions and non-interlaced images drawn over a canvas.
+struct DecodedGif
+{
+	unsigned width = 0;
+	unsigned height = 0;
+	std::vector<std::vector<uint8_t>> frames;		// The whole canvas after each image.
+	std::vector<unsigned> delays;
+	bool valid = false;
+};
+
+
+static DecodedGif decode_gif(const std::string& data)
+{
+	DecodedGif gif;
+	size_t pos = 0;
+	auto byte = [&]() { return pos < data.size() ? uint8_t(data[pos++]) : 0; };
+	auto word = [&]() { unsigned low = byte(); return low | (byte() << 8); };
+
+	if (data.compare(0, 6, "GIF89a") != 0)
+	{
+		return gif;
+	}
+	pos = 6;
+	gif.width = word();
+	gif.height = word();
+	uint8_t flags = byte();
+	pos += 2 + 3 * (2 << (flags & 7));
+	std::vector<uint8_t> canvas(gif.width * gif.height, 0);
+	unsigned delay = 0;
+
+	while (pos < data.size())
+	{
+		uint8_t introducer = byte();
+		if (introducer == 0x3b)
+		{
+			gif.valid = true;
+			return gif;
+		}
+		if (introducer == 0x21)
+		{
+			uint8_t label = byte();
+			std::string payload;
+			for (uint8_t size; (size = byte()) != 0; pos += size)
+			{
+				payload += data.substr(pos, size);
+			}
+			if (label == 0xf9)
+			{
+				delay = uint8_t(payload[2]) << 8 | uint8_t(payload[1]);
+			}
+			continue;
+		}
+		if (introducer != 0x2c)
+		{
+			return gif;
+		}
+
+		unsigned left = word(), top = word(), width = word(), height = word();
+		byte();
+		unsigned minimum_size = byte();
+		std::string compressed;
+		for (uint8_t size; (size = byte()) != 0; pos += size)
+		{
+			compressed += data.substr(pos, size);
+		}
+
+		// LZW decode, growing the code size after each new entry in the way that GIF decoders do.
+		const unsigned clear = 1 << minimum_size, end = clear + 1;
+		std::vector<std::vector<uint8_t>> table;
+		std::vector<uint8_t> pixels;
+		unsigned size = minimum_size + 1;
+		size_t bit = 0;
+		int previous = -1;
+		auto reset = [&]() {
+			table.clear();
+			for (unsigned n = 0; n < clear + 2; n++)
+			{
+				table.push_back({ uint8_t(n) });
+			}
+			size = minimum_size + 1;
+			previous = -1;
+		};
+		reset();
+		while (bit + size <= compressed.size() * 8)
+		{
+			unsigned code = 0;
+			for (unsigned n = 0; n < size; n++, bit++)
+			{
+				code |= ((uint8_t(compressed[bit / 8]) >> (bit % 8)) & 1) << n;
+			}
+			if (code == clear)
+			{
+				reset();
+				continue;
+			}
+			if (code == end)
+			{
+				break;
+			}
+			std::vector<uint8_t> entry;
+			if (code < table.size())
+			{
+				entry = table[code];
+			}
+			else if (code == table.size() && previous >= 0)
+			{
+				entry = table[previous];
+				entry.push_back(table[previous][0]);
+			}
+			else
+			{
+				return gif;
+			}
+			if (previous >= 0 && table.size() < 4096)
+			{
+				std::vector<uint8_t> added = table[previous];
+				added.push_back(entry[0]);
+				table.push_back(added);
+				if (table.size() == (1u << size) && size < 12)
+				{
+					size++;
+				}
+			}
+			pixels.insert(pixels.end(), entry.begin(), entry.end());
+			previous = code;
+		}
+		if (pixels.size() != width * height)
+		{
+			return gif;
+		}
+		for (unsigned y = 0; y < height; y++)
+		{
+			for (unsigned x = 0; x < width; x++)
+			{
+				canvas[(top + y) * gif.width + left + x] = pixels[y * width + x];
+			}
+		}
+		gif.frames.push_back(canvas);
+		gif.delays.push_back(delay);
+	}
+	return gif;
+}
+
+
+// The canvas that a screen should decode to.
+static std::vector<uint8_t> expected_canvas(const Chip8Screen& screen, unsigned scale)
+{
+	std::vector<uint8_t> canvas;
+	for (unsigned y = 0; y < 32 * scale; y++)
+	{
+		for (unsigned x = 0; x < 64 * scale; x++)
+		{
+			canvas.push_back(screen.test(x / scale + 64 * (y / scale)) ? 1 : 0);
+		}
+	}
+	return canvas;
+}
+
+
+TEST_CASE("GIF writer")
+{
+	Chip8VM vm;
+	compile_scribble(vm);
+	std::ostringstream out;
+
+	SECTION("frames decode to the screens that were written")
+	{
+		for (unsigned scale : { 1, 3 })
+		{
+			out.str("");
+			GifWriter gif(out, scale);
+			std::vector<std::vector<uint8_t>> screens;
+			for (auto frame = 0; frame < 40; frame++)
+			{
+				vm.step(6);
+				gif.write(vm.io.screen);
+				screens.push_back(expected_canvas(vm.io.screen, scale));
+			}
+			gif.finish();
+
+			// Every frame changes and lasts 5/3 centiseconds, so the ones that would round to a single centisecond
+			// are dropped.
+			DecodedGif decoded = decode_gif(out.str());
+			REQUIRE(decoded.valid);
+			REQUIRE(decoded.width == 64 * scale);
+			REQUIRE(decoded.height == 32 * scale);
+			REQUIRE(decoded.frames.size() == gif.written());
+			REQUIRE(gif.written() < 40);
+			unsigned centiseconds = 0;
+			for (size_t n = 0; n < decoded.frames.size(); n++)
+			{
+				REQUIRE(decoded.delays[n] >= 2);
+				centiseconds += decoded.delays[n];
+			}
+			REQUIRE(centiseconds == 40 * 100 / 60 + 1);
+			REQUIRE(decoded.frames.back() == screens.back());
+		}
+	}
+
+	SECTION("identical frames are merged into a longer delay")
+	{
+		GifWriter gif(out);
+		std::vector<std::vector<uint8_t>> screens;
+		for (auto change = 0; change < 5; change++)
+		{
+			vm.step(6);
+			screens.push_back(expected_canvas(vm.io.screen, 1));
+			for (auto frame = 0; frame < 30; frame++)
+			{
+				gif.write(vm.io.screen);
+			}
+		}
+		gif.finish();
+
+		DecodedGif decoded = decode_gif(out.str());
+		REQUIRE(decoded.valid);
+		REQUIRE(decoded.frames == screens);
+		REQUIRE(decoded.delays == std::vector<unsigned>(5, 50));
+	}
+
+	SECTION("long runs of pixels fill the dictionary and clear it")
+	{
+		GifWriter gif(out, 8);
+		for (auto frame = 0; frame < 3; frame++)
+		{
+			vm.step(500);
+			gif.write(vm.io.screen);
+			gif.write(vm.io.screen);
+		}
+		gif.finish();
+		REQUIRE(decode_gif(out.str()).frames.back() == expected_canvas(vm.io.screen, 8));
+	}
+}
@@ -0,0 +1,146 @@
+#include "catch.hpp"
+
+#include <algorithm>
+#include <thread>
+
+#include <libChip-8/include/handoff.hpp>
+
+
+TEST_CASE("Triple buffer")
+{
+	SECTION("the reader sees the latest published value")
+	{
+		TripleBuffer<int> buffer;
+		buffer.back() = 0;
+		buffer.publish();
+		REQUIRE(buffer.update());
+		REQUIRE(buffer.front() == 0);
+		REQUIRE_FALSE(buffer.update());
+
+		for (int n = 1; n <= 3; n++)
+		{
+			buffer.back() = n;
+			buffer.publish();
+		}
+		REQUIRE(buffer.update());
+		REQUIRE(buffer.front() == 3);
+		REQUIRE_FALSE(buffer.update());
+		REQUIRE(buffer.front() == 3);
+	}
+
+	SECTION("values are handed between threads whole and in order")
+	{
+		struct Frame
+		{
+			uint64_t number;
+			uint64_t copies[16];
+		};
+		TripleBuffer<Frame> buffer;
+		const uint64_t FRAMES = 200000;
+
+		std::thread writer([&]() {
+			for (uint64_t n = 1; n <= FRAMES; n++)
+			{
+				Frame& frame = buffer.back();
+				frame.number = n;
+				for (auto& copy : frame.copies)
+				{
+					copy = n;
+				}
+				buffer.publish();
+			}
+		});
+
+		uint64_t last = 0;
+		bool torn = false;
+		bool backwards = false;
+		while (last < FRAMES)
+		{
+			if (buffer.update())
+			{
+				const Frame& frame = buffer.front();
+				for (auto copy : frame.copies)
+				{
+					torn |= copy != frame.number;
+				}
+				backwards |= frame.number <= last;
+				last = frame.number;
+			}
+		}
+		writer.join();
+		REQUIRE_FALSE(torn);
+		REQUIRE_FALSE(backwards);
+	}
+}
+
+
+TEST_CASE("Single producer, single consumer queue")
+{
+	SECTION("items come out in order until it's empty")
+	{
+		SpscQueue<int, 4> queue;
+		int item = -1;
+		REQUIRE_FALSE(queue.pop(item));
+		for (int n = 0; n < 4; n++)
+		{
+			REQUIRE(queue.push(n));
+		}
+		REQUIRE_FALSE(queue.push(4));
+		for (int n = 0; n < 4; n++)
+		{
+			REQUIRE(queue.pop(item));
+			REQUIRE(item == n);
+		}
+		REQUIRE_FALSE(queue.pop(item));
+		REQUIRE(queue.push(5));
+		REQUIRE(queue.pop(item));
+		REQUIRE(item == 5);
+	}
+
+	SECTION("items can be pushed and popped in bulk across the wrap")
+	{
+		SpscQueue<int, 8> queue;
+		int in[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+		int out[10] = {};
+		REQUIRE(queue.push(in, 5) == 5);
+		REQUIRE(queue.pop(out, 3) == 3);
+		REQUIRE(queue.push(in + 5, 5) == 5);
+		REQUIRE(queue.size() == 7);
+		REQUIRE(queue.push(in, 10) == 1);
+		REQUIRE(queue.pop(out + 3, 7) == 7);
+		REQUIRE(std::equal(in, in + 10, out));
+		REQUIRE(queue.pop(out, 10) == 1);
+		REQUIRE(out[0] == 0);
+		REQUIRE(queue.pop(out, 10) == 0);
+	}
+
+	SECTION("no items are lost or reordered between threads")
+	{
+		SpscQueue<uint32_t, 64> queue;
+		const uint32_t ITEMS = 500000;
+
+		std::thread producer([&]() {
+			for (uint32_t n = 0; n < ITEMS; n++)
+			{
+				while (!queue.push(n))
+				{
+					std::this_thread::yield();
+				}
+			}
+		});
+
+		uint32_t expected = 0;
+		bool ordered = true;
+		while (expected < ITEMS)
+		{
+			uint32_t item;
+			if (queue.pop(item))
+			{
+				ordered &= item == expected;
+				expected++;
+			}
+		}
+		producer.join();
+		REQUIRE(ordered);
+	}
+}
@@ -0,0 +1,93 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <libChip-8/include/histogram.hpp>
+
+
+using namespace std::chrono;
+
+
+TEST_CASE("Latency histogram")
+{
+	LatencyHistogram histogram;
+
+	SECTION("buckets are within an eighth of the durations in them")
+	{
+		for (uint64_t nanoseconds = 1; nanoseconds < (1ull << 40); nanoseconds = nanoseconds * 3 / 2 + 1)
+		{
+			size_t bucket = LatencyHistogram::bucket(nanoseconds);
+			REQUIRE(bucket < LatencyHistogram::BUCKETS);
+			REQUIRE(LatencyHistogram::bucket(LatencyHistogram::bucket_value(bucket)) == bucket);
+			uint64_t value = LatencyHistogram::bucket_value(bucket);
+			uint64_t error = value > nanoseconds ? value - nanoseconds : nanoseconds - value;
+			REQUIRE(error * 8 <= nanoseconds);
+		}
+		REQUIRE(LatencyHistogram::bucket(~0ull) < LatencyHistogram::BUCKETS);
+	}
+
+	SECTION("an empty histogram summarises to zeros")
+	{
+		auto summary = histogram.summary();
+		REQUIRE(summary.count == 0);
+		REQUIRE(summary.maximum == 0);
+	}
+
+	SECTION("percentiles come from the buckets")
+	{
+		for (auto n = 1; n <= 100; n++)
+		{
+			histogram.record(milliseconds(n));
+		}
+		auto summary = histogram.summary();
+		REQUIRE(summary.count == 100);
+		REQUIRE(summary.mean == 50500000);
+		REQUIRE(summary.maximum == 100000000);
+		REQUIRE(summary.p50 == Approx(50000000).epsilon(0.07));
+		REQUIRE(summary.p90 == Approx(90000000).epsilon(0.07));
+		REQUIRE(summary.p99 == Approx(99000000).epsilon(0.07));
+		REQUIRE(summary.p99 <= summary.maximum);
+	}
+
+	SECTION("taking a summary empties the histogram")
+	{
+		histogram.record(microseconds(5));
+		REQUIRE(histogram.take().count == 1);
+		REQUIRE(histogram.summary().count == 0);
+		histogram.record(microseconds(7));
+		REQUIRE(histogram.take().maximum == 7000);
+	}
+
+	SECTION("threads can record at once")
+	{
+		std::vector<std::thread> threads;
+		for (auto t = 0; t < 4; t++)
+		{
+			threads.emplace_back([&histogram, t]() {
+				for (auto n = 0; n < 100000; n++)
+				{
+					histogram.record(nanoseconds(1000 + t));
+				}
+			});
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		auto summary = histogram.summary();
+		REQUIRE(summary.count == 400000);
+		REQUIRE(summary.maximum == 1003);
+	}
+
+	SECTION("summaries are written in milliseconds")
+	{
+		histogram.record(microseconds(1500));
+		std::ostringstream out;
+		LatencyHistogram::write_heading(out);
+		LatencyHistogram::write(out, "present", histogram.summary());
+		REQUIRE(out.str().find("count") != std::string::npos);
+		REQUIRE(out.str().find("present                  1    1.500") != std::string::npos);
+	}
+}
@@ -0,0 +1,142 @@
+#include "catch.hpp"
+
+#include <sstream>
+
+#include <libChip-8/include/inputlog.hpp>
+
+
+TEST_CASE("Input log")
+{
+	// Waits for a key, then draws a random sprite while the delay timer runs down.
+	Chip8VM::Byte program[] = {
+		0xf0, 0x0a,		// LD V0, K
+		0xc1, 0xff,		// RND V1, FFH
+		0xf0, 0x29,		// LD F, V0
+		0xd1, 0x15,		// DRW V1, V1, 5
+		0xf1, 0x15,		// LD DT, V1
+		0xf2, 0x07,		// LD V2, DT
+		0x32, 0x00,		// SE V2, 0
+		0x12, 0x0a,		// JP 20AH
+		0x12, 0x00		// JP 200H
+	};
+
+	Chip8VM vm;
+	InputLog log;
+	log.start(program, sizeof(program), 42);
+	vm.load(program, sizeof(program), 42);
+	for (auto frame = 0; frame < 300; frame++)
+	{
+		if (frame % 7 == 3)
+		{
+			auto key = static_cast<Chip8VM::Key>(frame % 16);
+			log.record(vm, InputLog::Type::KEY_DOWN, key);
+			vm.key_pressed(key);
+			vm.step(3);
+			log.record(vm, InputLog::Type::KEY_UP, key);
+			vm.key_released(key);
+		}
+		log.record(vm, InputLog::Type::TICK);
+		vm.tick();
+		vm.step(10);
+		if (frame % 50 == 49)
+		{
+			log.checkpoint(vm);
+		}
+	}
+	log.finish(vm);
+
+	SECTION("replaying reproduces the session")
+	{
+		Chip8VM other;
+		REQUIRE(replay(other, log, program, sizeof(program)));
+		REQUIRE(other.instructions == vm.instructions);
+		REQUIRE(other.hash() == vm.hash());
+	}
+
+	SECTION("a log only replays against its own program")
+	{
+		Chip8VM other;
+		program[1] = 0x0b;
+		REQUIRE(!replay(other, log, program, sizeof(program)));
+	}
+
+	SECTION("segments verify independently")
+	{
+		auto results = verify(log, program, sizeof(program), 4);
+		REQUIRE(results.size() == 7);
+		for (const auto& result : results)
+		{
+			REQUIRE(result.matched);
+		}
+		REQUIRE(results.back().end == vm.instructions);
+	}
+
+	SECTION("a saved log loads back")
+	{
+		std::stringstream file;
+		REQUIRE(log.save(file));
+		InputLog loaded;
+		REQUIRE(loaded.load(file));
+		REQUIRE(loaded.events.size() == log.events.size());
+		REQUIRE(loaded.checkpoints.size() == log.checkpoints.size());
+		Chip8VM other;
+		REQUIRE(replay(other, loaded, program, sizeof(program)));
+		REQUIRE(other.hash() == vm.hash());
+	}
+
+	SECTION("corrupt logs are rejected")
+	{
+		InputLog loaded;
+		auto rejects = [&](const InputLog& corrupt) {
+			std::stringstream file;
+			corrupt.save(file);
+			return !loaded.load(file);
+		};
+
+		InputLog corrupt = log;
+		corrupt.events[3].key = 0x10;
+		REQUIRE(corrupt.events[3].type != InputLog::Type::TICK);
+		REQUIRE(rejects(corrupt));
+
+		corrupt = log;
+		corrupt.events[3].type = static_cast<InputLog::Type>(3);
+		REQUIRE(rejects(corrupt));
+
+		corrupt = log;
+		corrupt.checkpoints[1].event = corrupt.events.size() + 1;
+		REQUIRE(rejects(corrupt));
+
+		corrupt = log;
+		corrupt.checkpoints[1].state.pc = 0x1000;
+		REQUIRE(rejects(corrupt));
+
+		// A count that the file can't hold is rejected before anything is allocated for it.
+		std::stringstream file;
+		log.save(file);
+		std::string bytes = file.str();
+		std::stringstream truncated(bytes.substr(0, bytes.size() - 1));
+		REQUIRE(!loaded.load(truncated));
+
+		uint64_t huge = uint64_t(1) << 60;
+		bytes.replace(8 + 4 * sizeof(uint64_t), sizeof(huge), reinterpret_cast<const char*>(&huge), sizeof(huge));
+		std::stringstream inflated(bytes);
+		REQUIRE(!loaded.load(inflated));
+	}
+
+	SECTION("divergence is pinned to a segment")
+	{
+		// Drop a timer tick.
+		auto n = log.checkpoints[2].event;
+		while (log.events[n].type != InputLog::Type::TICK)
+		{
+			n++;
+		}
+		log.events[n].type = InputLog::Type::KEY_UP;
+		log.events[n].key = 0;
+		auto results = verify(log, program, sizeof(program));
+		for (size_t segment = 0; segment < results.size(); segment++)
+		{
+			REQUIRE(results[segment].matched == (segment != 3));
+		}
+	}
+}
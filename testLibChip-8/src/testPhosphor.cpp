@@ -0,0 +1,63 @@
+#include "catch.hpp"
+
+#include <vector>
+
+#include <libChip-8/include/phosphor.hpp>
+
+
+TEST_CASE("Phosphor")
+{
+	Chip8VM vm;
+	Phosphor phosphor(0x80);
+	vm.io.screen.rows[3] = 0x8000000000000001ull;
+	phosphor.tick(vm.io.screen);
+
+	SECTION("lit pixels are at full intensity")
+	{
+		const uint8_t* intensity = phosphor.intensities();
+		for (auto n = 0; n < Phosphor::WIDTH * Phosphor::HEIGHT; n++)
+		{
+			REQUIRE(intensity[n] == (n == 3 * 64 || n == 3 * 64 + 63 ? 0xff : 0));
+		}
+	}
+
+	SECTION("unlit pixels fade each tick")
+	{
+		vm.io.screen.rows[3] = 0x0000000000000001ull;
+		phosphor.tick(vm.io.screen);
+		REQUIRE(phosphor.intensities()[3 * 64] == 0x7f);
+		REQUIRE(phosphor.intensities()[3 * 64 + 63] == 0xff);
+		phosphor.tick(vm.io.screen);
+		REQUIRE(phosphor.intensities()[3 * 64] == 0x3f);
+		for (auto n = 0; n < 8; n++)
+		{
+			phosphor.tick(vm.io.screen);
+		}
+		REQUIRE(phosphor.intensities()[3 * 64] == 0);
+	}
+
+	SECTION("the rendered frame blends between the palette's colours")
+	{
+		vm.io.screen.rows[3] = 0x0000000000000001ull;
+		phosphor.tick(vm.io.screen);
+
+		std::vector<uint8_t> pixels(64 * 32 * 4);
+		phosphor.set_palette(Palette(0xff000000, 0xff20ff80));
+		phosphor.render(pixels.data(), 64 * 4);
+		const uint8_t* faded = &pixels[3 * 64 * 4];
+		const uint8_t* lit = &pixels[(3 * 64 + 63) * 4];
+		const uint8_t* dark = &pixels[0];
+		REQUIRE(faded[0] == 0x10);
+		REQUIRE(faded[1] == 0x7f);
+		REQUIRE(faded[2] == 0x40);
+		REQUIRE(faded[3] == 0xff);
+		REQUIRE(lit[0] == 0x20);
+		REQUIRE(lit[1] == 0xff);
+		REQUIRE(lit[2] == 0x80);
+		REQUIRE(lit[3] == 0xff);
+		REQUIRE(dark[0] == 0x00);
+		REQUIRE(dark[1] == 0x00);
+		REQUIRE(dark[2] == 0x00);
+		REQUIRE(dark[3] == 0xff);
+	}
+}
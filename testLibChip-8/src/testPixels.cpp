@@ -0,0 +1,73 @@
+#include "catch.hpp"
+#include "scribble.hpp"
+
+#include <vector>
+
+#include <libChip-8/include/chip8vm.hpp>
+#include <libChip-8/include/pixels.hpp>
+
+
+TEST_CASE("Pixel expansion")
+{
+	// Draw something irregular so that every bit position is exercised.
+	Chip8VM vm;
+	compile_scribble(vm);
+	vm.step(400);
+	const uint64_t* rows = vm.io.screen.rows.data();
+
+	const Palette palette(0xff102030, 0xffe0d0c0);
+	const PixelFormat formats[] = { PixelFormat::RGBA8, PixelFormat::RGB565, PixelFormat::GRAY8 };
+	const SimdLevel levels[] = { SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2 };
+	const unsigned scales[] = { 1, 2, 3, 5, 16 };
+
+	SECTION("every pixel is the palette colour")
+	{
+		std::vector<uint8_t> pixels(64 * 32 * 4);
+		expand_pixels(rows, 32, PixelFormat::RGBA8, palette, 1, pixels.data(), 64 * 4, SimdLevel::SCALAR);
+		for (auto y = 0; y < 32; y++)
+		{
+			for (auto x = 0; x < 64; x++)
+			{
+				const uint8_t* pixel = &pixels[(x + 64 * y) * 4];
+				bool lit = vm.io.screen.test(x + 64 * y);
+				REQUIRE(pixel[0] == (lit ? 0xe0 : 0x10));
+				REQUIRE(pixel[1] == (lit ? 0xd0 : 0x20));
+				REQUIRE(pixel[2] == (lit ? 0xc0 : 0x30));
+				REQUIRE(pixel[3] == 0xff);
+			}
+		}
+	}
+
+	SECTION("scaling repeats each pixel in both directions")
+	{
+		std::vector<uint8_t> pixels(64 * 3 * 32 * 3);
+		expand_pixels(rows, 32, PixelFormat::GRAY8, Palette(0xff000000, 0xffffffff), 3, pixels.data(), 64 * 3, SimdLevel::SCALAR);
+		for (auto y = 0; y < 32 * 3; y++)
+		{
+			for (auto x = 0; x < 64 * 3; x++)
+			{
+				bool lit = vm.io.screen.test(x / 3 + 64 * (y / 3));
+				REQUIRE(pixels[x + 64 * 3 * y] == (lit ? 0xff : 0x00));
+			}
+		}
+	}
+
+	SECTION("every instruction set gives the same result")
+	{
+		for (auto format : formats)
+		{
+			for (auto scale : scales)
+			{
+				size_t pitch = 64 * scale * bytes_per_pixel(format) + 8;
+				std::vector<uint8_t> expected(pitch * 32 * scale, 0xaa);
+				expand_pixels(rows, 32, format, palette, scale, expected.data(), pitch, SimdLevel::SCALAR);
+				for (auto level : levels)
+				{
+					std::vector<uint8_t> actual(pitch * 32 * scale, 0xaa);
+					expand_pixels(rows, 32, format, palette, scale, actual.data(), pitch, level);
+					REQUIRE(actual == expected);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,59 @@
+#include "catch.hpp"
+#include "scribble.hpp"
+
+#include <vector>
+
+#include <libChip-8/include/rewind.hpp>
+
+
+TEST_CASE("Rewind buffer")
+{
+	Chip8VM vm;
+	compile_scribble(vm);
+
+	RewindBuffer rewind(50, 10);
+	std::vector<uint64_t> hashes;
+	for (auto frame = 0; frame < 200; frame++)
+	{
+		rewind.push(vm);
+		hashes.push_back(vm.hash());
+		vm.tick();
+		vm.step(10);
+	}
+
+	SECTION("only the most recent frames are kept")
+	{
+		REQUIRE(rewind.newest() == 199);
+		REQUIRE(rewind.oldest() == 150);
+		REQUIRE(!rewind.seek(149, vm));
+		REQUIRE(!rewind.seek(200, vm));
+	}
+
+	SECTION("any kept frame can be sought")
+	{
+		for (uint64_t frame = rewind.oldest(); frame <= rewind.newest(); frame++)
+		{
+			REQUIRE(rewind.seek(frame, vm));
+			REQUIRE(vm.hash() == hashes[frame]);
+		}
+	}
+
+	SECTION("deltas are smaller than keyframes")
+	{
+		REQUIRE(rewind.bytes() < 50 * sizeof(Chip8VM::State) / 2);
+	}
+
+	SECTION("recording continues after a rewind")
+	{
+		REQUIRE(rewind.rewind(175, vm));
+		vm.tick();
+		vm.step(10);
+		rewind.push(vm);
+		REQUIRE(rewind.newest() == 176);
+		REQUIRE(rewind.oldest() == 150);
+		REQUIRE(rewind.seek(176, vm));
+		REQUIRE(vm.hash() == hashes[176]);
+		REQUIRE(rewind.seek(150, vm));
+		REQUIRE(vm.hash() == hashes[150]);
+	}
+}
@@ -0,0 +1,107 @@
+#include "catch.hpp"
+
+#include <string>
+
+#include <libChip-8/include/scheduler.hpp>
+
+
+using namespace std::chrono;
+
+
+TEST_CASE("Scheduler")
+{
+	// Records the schedule as a string of instruction counts and ticks, e.g. "10 T 10 T 5".
+	std::string schedule;
+	auto tick = [&]() { schedule += "T "; };
+	auto step = [&](uint32_t n) { schedule += std::to_string(n) + " "; };
+
+	SECTION("a second runs the set number of instructions and 60 ticks")
+	{
+		for (uint32_t rate : { 600, 700, 1000000 })
+		{
+			Scheduler scheduler(rate);
+			for (auto n = 0; n < 100; n++)
+			{
+				scheduler.advance(milliseconds(10), tick, step);
+			}
+			REQUIRE(scheduler.instructions() == rate);
+			REQUIRE(scheduler.ticks() == 60);
+		}
+	}
+
+	SECTION("ticks fall on the instruction boundaries that match their time")
+	{
+		Scheduler scheduler(600);
+		scheduler.advance(milliseconds(40), tick, step);
+		REQUIRE(schedule == "10 T 10 T 4 ");
+		REQUIRE(scheduler.until_tick() == nanoseconds(50000000 - 40000000));
+	}
+
+	SECTION("the schedule doesn't depend on how time is sliced")
+	{
+		Scheduler whole(1234);
+		whole.advance(milliseconds(200), tick, step);
+		std::string expected;
+		std::swap(expected, schedule);
+
+		// Merge the slices' consecutive steps to compare.
+		Scheduler sliced(1234);
+		uint32_t pending = 0;
+		auto sliced_step = [&](uint32_t n) { pending += n; };
+		auto sliced_tick = [&]() {
+			step(pending);
+			pending = 0;
+			tick();
+		};
+		for (auto n = 0; n < 200; n++)
+		{
+			sliced.advance(microseconds(n % 2 ? 1700 : 300), sliced_tick, sliced_step);
+		}
+		REQUIRE(sliced.ticks() == whole.ticks());
+		REQUIRE(schedule.compare(0, schedule.size(), expected, 0, schedule.size()) == 0);
+	}
+
+	SECTION("advancing to each tick runs a frame at a time")
+	{
+		Scheduler scheduler(700);
+		for (auto n = 0; n < 6; n++)
+		{
+			scheduler.advance(scheduler.until_tick(), tick, step);
+		}
+		REQUIRE(schedule == "11 T 12 T 12 T 11 T 12 T 12 T ");
+	}
+
+	SECTION("advancing to an event's time stops at the instruction boundary that matches it")
+	{
+		// An event 25 ms into a run at 600 instructions per second lands after instruction 15, between the first two
+		// ticks, and the run carries on from there as if it hadn't been split.
+		Scheduler scheduler(600);
+		scheduler.advance(milliseconds(25), tick, step);
+		REQUIRE(scheduler.instructions() == 15);
+		REQUIRE(scheduler.ticks() == 1);
+		schedule += "E ";
+		scheduler.advance(milliseconds(15), tick, step);
+		REQUIRE(schedule == "10 T 5 E 5 T 4 ");
+	}
+
+	SECTION("a long stall isn't caught up on")
+	{
+		Scheduler scheduler(600);
+		scheduler.advance(seconds(10), tick, step);
+		REQUIRE(scheduler.ticks() == 15);
+		REQUIRE(scheduler.instructions() == 150);
+	}
+
+	SECTION("changing the rate keeps the timers steady")
+	{
+		Scheduler scheduler(600);
+		scheduler.advance(milliseconds(250), tick, step);
+		scheduler.advance(milliseconds(250), tick, step);
+		scheduler.set_rate(1200);
+		scheduler.advance(milliseconds(250), tick, step);
+		scheduler.advance(milliseconds(250), tick, step);
+		REQUIRE(scheduler.ticks() == 60);
+		REQUIRE(scheduler.instructions() == 300 + 600);
+		REQUIRE(scheduler.rate() == 1200);
+	}
+}
@@ -0,0 +1,72 @@
+#include "catch.hpp"
+
+#include <string>
+
+#include <libChip-8/include/terminal.hpp>
+
+
+TEST_CASE("Terminal renderer")
+{
+	Chip8Screen screen = {};
+	std::string out;
+	auto set = [&](unsigned x, unsigned y) { screen.rows[y] |= 1ull << (63 - x); };
+
+	SECTION("braille cells cover 2x4 pixels")
+	{
+		TerminalRenderer terminal;
+		REQUIRE(terminal.columns() == 32);
+		REQUIRE(terminal.rows() == 8);
+
+		// The first render draws every cell, moving the cursor once per line.
+		REQUIRE(terminal.render(screen, out) == 32 * 8);
+		REQUIRE(out.find("\x1b[1;1H\xe2\xa0\x80\xe2\xa0\x80") == 0);
+		REQUIRE(out.find("\x1b[8;1H") != std::string::npos);
+
+		// An unchanged screen sends nothing.
+		out.clear();
+		REQUIRE(terminal.render(screen, out) == 0);
+		REQUIRE(out.empty());
+
+		// Pixel (3, 3) is dot 8 of the cell in column 1, row 0: U+2880.
+		set(3, 3);
+		REQUIRE(terminal.render(screen, out) == 1);
+		REQUIRE(out == "\x1b[1;2H\xe2\xa2\x80");
+
+		// Neighbouring changed cells share a cursor move.
+		out.clear();
+		set(4, 0);
+		set(6, 2);
+		REQUIRE(terminal.render(screen, out) == 2);
+		REQUIRE(out == "\x1b[1;3H\xe2\xa0\x81\xe2\xa0\x84");
+
+		// Invalidating redraws everything.
+		out.clear();
+		terminal.invalidate();
+		REQUIRE(terminal.render(screen, out) == 32 * 8);
+	}
+
+	SECTION("half blocks cover 1x2 pixels")
+	{
+		TerminalRenderer terminal(TerminalRenderer::Mode::HALF_BLOCK, 3, 5);
+		REQUIRE(terminal.columns() == 64);
+		REQUIRE(terminal.rows() == 16);
+		terminal.render(screen, out);
+		REQUIRE(out.compare(0, 7, "\x1b[3;5H ") == 0);
+
+		out.clear();
+		set(63, 31);
+		REQUIRE(terminal.render(screen, out) == 1);
+		REQUIRE(out == "\x1b[18;68H\xe2\x96\x84");
+
+		out.clear();
+		set(63, 30);
+		terminal.render(screen, out);
+		REQUIRE(out == "\x1b[18;68H\xe2\x96\x88");
+
+		out.clear();
+		screen.rows.fill(0);
+		set(0, 0);
+		terminal.render(screen, out);
+		REQUIRE(out == "\x1b[3;5H\xe2\x96\x80\x1b[18;68H ");
+	}
+}
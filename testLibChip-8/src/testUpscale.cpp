@@ -0,0 +1,183 @@
+#include "catch.hpp"
+#include "scribble.hpp"
+
+#include <chrono>
+#include <vector>
+
+#include <libChip-8/include/chip8vm.hpp>
+#include <libChip-8/include/pixels.hpp>
+#include <libChip-8/include/upscale.hpp>
+
+
+// A packed one-bit image with a pixel at a time accessor, clamping at the edges like the upscalers.
+struct Image
+{
+	size_t words;
+	size_t height;
+	std::vector<uint64_t> data;
+
+	Image(size_t words, size_t height) : words(words), height(height), data(words * height) {}
+
+	bool get(long x, long y) const
+	{
+		x = std::max(0l, std::min(x, long(words * 64) - 1));
+		y = std::max(0l, std::min(y, long(height) - 1));
+		return ((data[y * words + x / 64] >> (63 - x % 64)) & 1) != 0;
+	}
+
+	void set(long x, long y, bool lit)
+	{
+		uint64_t bit = 1ull << (63 - x % 64);
+		uint64_t& word = data[y * words + x / 64];
+		word = lit ? word | bit : word & ~bit;
+	}
+};
+
+
+// Straightforward implementations of the published Scale2x and Scale3x rules.
+static Image reference_scale2x(const Image& in)
+{
+	Image out(in.words * 2, in.height * 2);
+	for (long y = 0; y < long(in.height); y++)
+	{
+		for (long x = 0; x < long(in.words * 64); x++)
+		{
+			bool b = in.get(x, y - 1), d = in.get(x - 1, y), e = in.get(x, y), f = in.get(x + 1, y), h = in.get(x, y + 1);
+			bool e0 = e, e1 = e, e2 = e, e3 = e;
+			if (b != h && d != f)
+			{
+				e0 = d == b ? d : e;
+				e1 = b == f ? f : e;
+				e2 = d == h ? d : e;
+				e3 = h == f ? f : e;
+			}
+			out.set(2 * x, 2 * y, e0);
+			out.set(2 * x + 1, 2 * y, e1);
+			out.set(2 * x, 2 * y + 1, e2);
+			out.set(2 * x + 1, 2 * y + 1, e3);
+		}
+	}
+	return out;
+}
+
+
+static Image reference_scale3x(const Image& in)
+{
+	Image out(in.words * 3, in.height * 3);
+	for (long y = 0; y < long(in.height); y++)
+	{
+		for (long x = 0; x < long(in.words * 64); x++)
+		{
+			bool a = in.get(x - 1, y - 1), b = in.get(x, y - 1), c = in.get(x + 1, y - 1);
+			bool d = in.get(x - 1, y), e = in.get(x, y), f = in.get(x + 1, y);
+			bool g = in.get(x - 1, y + 1), h = in.get(x, y + 1), i = in.get(x + 1, y + 1);
+			bool p[9] = { e, e, e, e, e, e, e, e, e };
+			if (b != h && d != f)
+			{
+				p[0] = d == b ? d : e;
+				p[1] = (d == b && e != c) || (b == f && e != a) ? b : e;
+				p[2] = b == f ? f : e;
+				p[3] = (d == b && e != g) || (d == h && e != a) ? d : e;
+				p[5] = (b == f && e != i) || (h == f && e != c) ? f : e;
+				p[6] = d == h ? d : e;
+				p[7] = (d == h && e != i) || (h == f && e != g) ? h : e;
+				p[8] = h == f ? f : e;
+			}
+			for (auto n = 0; n < 9; n++)
+			{
+				out.set(3 * x + n % 3, 3 * y + n / 3, p[n]);
+			}
+		}
+	}
+	return out;
+}
+
+
+// Tiles an image with successive screens of random digits.
+static Image scribble(size_t words, size_t height)
+{
+	Chip8VM vm;
+	compile_scribble(vm);
+
+	Image image(words, height);
+	for (size_t top = 0; top < height; top += Chip8VM::SCREEN_HEIGHT)
+	{
+		for (size_t word = 0; word < words; word++)
+		{
+			vm.step(60);
+			for (size_t y = top; y < height && y < top + Chip8VM::SCREEN_HEIGHT; y++)
+			{
+				image.data[y * words + word] = vm.io.screen.rows[y - top];
+			}
+		}
+	}
+	return image;
+}
+
+
+TEST_CASE("Upscalers")
+{
+	SECTION("Scale2x follows the published rules")
+	{
+		for (size_t words = 1; words <= 2; words++)
+		{
+			Image in = scribble(words, 32 * words);
+			Image out(words * 2, in.height * 2);
+			scale2x(in.data.data(), in.words, in.height, out.data.data());
+			REQUIRE(out.data == reference_scale2x(in).data);
+		}
+	}
+
+	SECTION("Scale3x follows the published rules")
+	{
+		for (size_t words = 1; words <= 2; words++)
+		{
+			Image in = scribble(words, 32 * words);
+			Image out(words * 3, in.height * 3);
+			scale3x(in.data.data(), in.words, in.height, out.data.data());
+			REQUIRE(out.data == reference_scale3x(in).data);
+		}
+	}
+
+	SECTION("flat areas are left alone")
+	{
+		Image in(1, 32);
+		for (auto y = 16; y < 32; y++)
+		{
+			in.data[y] = ~0ull;
+		}
+		Image out(3, 96);
+		scale3x(in.data.data(), 1, 32, out.data.data());
+		for (auto y = 0; y < 96; y++)
+		{
+			for (auto k = 0; k < 3; k++)
+			{
+				REQUIRE(out.data[y * 3 + k] == (y < 48 ? 0 : ~0ull));
+			}
+		}
+	}
+}
+
+
+// Run with the [benchmark] tag to measure how many frames per second a core can upscale and expand to RGBA.
+TEST_CASE("Upscaler benchmark", "[.][benchmark]")
+{
+	const int FRAMES = 20000;
+	Image screen = scribble(1, 32);
+	std::vector<uint64_t> scaled(6 * 96);
+	std::vector<uint32_t> pixels(192 * 96);
+
+	auto measure = [&](const char* name, void (*filter)(const uint64_t*, size_t, size_t, uint64_t*), size_t factor) {
+		auto start = std::chrono::steady_clock::now();
+		for (auto frame = 0; frame < FRAMES; frame++)
+		{
+			screen.data[frame & 31] ^= frame;
+			filter(screen.data.data(), 1, 32, scaled.data());
+			expand_image(scaled.data(), factor, 32 * factor, PixelFormat::RGBA8, Palette(), 1, pixels.data(), 64 * factor * 4);
+		}
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		WARN(name << ": " << FRAMES / elapsed.count() << " frames per second");
+	};
+	measure("Scale2x", scale2x, 2);
+	measure("Scale3x", scale3x, 3);
+}
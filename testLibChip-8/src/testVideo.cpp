@@ -0,0 +1,64 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <string>
+
+#include <libChip-8/include/video.hpp>
+
+
+TEST_CASE("Video writer")
+{
+	Chip8VM vm;
+	std::ostringstream out;
+
+	SECTION("Y4M streams have a header and a frame marker before each frame")
+	{
+		VideoWriter video(out, VideoWriter::Format::Y4M, 2, Palette(0xff000000, 0xffffffff));
+		vm.io.screen.rows[0] = 0x8000000000000000ull;
+		video.write(vm.io.screen);
+		video.write(vm.io.screen);
+
+		std::string header = "YUV4MPEG2 W128 H64 F60:1 Ip A1:1 C444\n";
+		size_t frame_size = 6 + 128 * 64 * 3;
+		std::string stream = out.str();
+		REQUIRE(stream.size() == header.size() + 2 * frame_size);
+		REQUIRE(stream.compare(0, header.size(), header) == 0);
+		REQUIRE(stream.compare(header.size(), 6, "FRAME\n") == 0);
+
+		// The lit pixel is white and the rest is black, in limited range YUV.
+		const char* y = stream.data() + header.size() + 6;
+		const char* u = y + 128 * 64;
+		REQUIRE(uint8_t(y[0]) == 235);
+		REQUIRE(uint8_t(y[129]) == 235);
+		REQUIRE(uint8_t(y[2]) == 16);
+		REQUIRE(uint8_t(u[0]) == 128);
+		REQUIRE(video.written() == 2);
+	}
+
+	SECTION("RGBA streams are bare frames")
+	{
+		VideoWriter video(out, VideoWriter::Format::RGBA, 1, Palette(0xff102030, 0xffffffff));
+		video.write(vm.io.screen);
+		std::string stream = out.str();
+		REQUIRE(stream.size() == 64 * 32 * 4);
+		REQUIRE(stream.compare(0, 4, "\x10\x20\x30\xff") == 0);
+	}
+
+	SECTION("with timestamps, only changed frames are written")
+	{
+		std::ostringstream timestamps;
+		VideoWriter video(out, VideoWriter::Format::RGBA, 1, Palette(), 60, &timestamps);
+		for (auto frame = 0; frame < 10; frame++)
+		{
+			if (frame == 3 || frame == 6)
+			{
+				vm.io.screen.rows[frame] = ~0ull;
+			}
+			video.write(vm.io.screen);
+		}
+		REQUIRE(video.frames() == 10);
+		REQUIRE(video.written() == 3);
+		REQUIRE(out.str().size() == 3 * 64 * 32 * 4);
+		REQUIRE(timestamps.str() == "# timecode format v2\n0.000\n50.000\n100.000\n");
+	}
+}